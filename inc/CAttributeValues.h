@@ -0,0 +1,34 @@
+//
+//  CAttributeValues.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CAttributeValues holds pre-rendered values of MEI attributes with small domains - pitch names, octaves,
+//  staff locations, clef lines and dot offsets - so that the attributes of each note are exported without
+//  formatting numbers or building strings. Values outside the tabulated ranges are rendered on demand.
+//
+
+#ifndef __Scribe2NeoScribe__CAttributeValues__
+#define __Scribe2NeoScribe__CAttributeValues__
+
+#include <string>
+
+#include "Header.h"
+
+
+class CAttributeValues {
+    
+public:
+    static const std::string&   letter(const char c);           //pname, ploc, clef shape, mensuration sign
+    static const std::string&   number(const int n);            //oct, oloc, loc, line, lines
+    static const std::string&   vertical_offset(const int tenths); //vo of dots, from the second Scribe argument (-4 to 4)
+    
+    static const std::string    red, blue, true_value;          //color and void
+    
+private:
+    static const int            min_number = -128, max_number = 255, max_offset = 4;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CAttributeValues__) */
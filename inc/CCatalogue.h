@@ -0,0 +1,42 @@
+//
+//  CCatalogue.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CCatalogue lists the pieces converted from a corpus, one tab delimited row per MEI file:
+//  MEI file, Scribe file, manuscript, folios, number (repertory or CAO), title
+//  Rows are kept sorted by MEI file so that catalogues merged from shards are deterministic.
+//
+
+#ifndef __Scribe2NeoScribe__CCatalogue__
+#define __Scribe2NeoScribe__CCatalogue__
+
+#include <iostream>
+#include <string>
+#include <map>
+
+#include "Header.h"
+
+class scribe_part;
+
+class CCatalogue {
+    
+public:
+    CCatalogue(const std::string& catalogue_file);
+    
+    void                    add(const std::string& xml_file, const std::string& scribe_file, const scribe_part& part);
+    void                    add(const std::string& xml_file, const std::string& row);
+    void                    merge(const CCatalogue& other);
+    void                    save() const;
+    const size_t            size() const { return rows.size(); }
+    
+private:
+    void            load_catalogue();
+    
+    std::string                             catalogue_file;
+    std::map<std::string, std::string>      rows;   //MEI file and the remainder of its row
+};
+
+#endif /* defined(__Scribe2NeoScribe__CCatalogue__) */
@@ -0,0 +1,47 @@
+//
+//  CJournal.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CJournal is an append-only record of the pieces and Scribe files committed by a batch conversion.
+//  If a batch is interrupted, the next run replays the journal into the manifest so that everything
+//  already committed is skipped. The journal is removed when a batch completes.
+//
+
+#ifndef __Scribe2NeoScribe__CJournal__
+#define __Scribe2NeoScribe__CJournal__
+
+#include <iostream>
+#include <string>
+#include <mutex>
+#include <set>
+
+#include "Header.h"
+
+class CManifest;
+class CMEIWriter;
+
+class CJournal {
+    
+public:
+    CJournal(const std::string& journal_file, const int sync_interval = 64);
+    ~CJournal();
+    
+    int                 replay(CManifest& manifest, const CMEIWriter* writer = NULL);
+    void                record(const std::string& key, const uint64_t fingerprint, const std::string& owner);
+    void                sync();
+    void                remove();
+    const bool          committed(const std::string& key) const { return committed_keys.count(key) > 0; }
+    
+private:
+    std::string         journal_file;
+    int                 fd = -1;
+    int                 sync_interval;      //records appended between fsyncs
+    int                 unsynced = 0;
+    std::mutex          lock;
+    std::set<std::string> committed_keys;   //keys accepted on replay
+};
+
+#endif /* defined(__Scribe2NeoScribe__CJournal__) */
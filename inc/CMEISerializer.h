@@ -0,0 +1,76 @@
+//
+//  CMEISerializer.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CMEISerializer appends MEI elements to a text as XML, either whole or as a start tag to be followed
+//  by its children and closed later, so that a document can be written while it is still being built
+//  and each finished part released. Elements are written as XmlExport writes them: the root with the
+//  MEI namespace and version, xml:id before other attributes, each element on a line of its own unless
+//  it is within an element that also holds text, and the text following an element (its tail) after it.
+//  All MEI files are written with it, so that text is escaped by the one (vectorised) escape routine.
+//  Unless pretty, elements are written without line breaks or indentation.
+//  Parts of documents that are the same in every document can be rendered once as fragments and written
+//  in place of stand-in elements, which then need not be built with their children for each document.
+//
+
+#ifndef __Scribe2NeoScribe__CMEISerializer__
+#define __Scribe2NeoScribe__CMEISerializer__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mei/mei.h>
+
+#include "Header.h"
+
+using namespace mei;
+
+
+class CMEISerializer {
+
+public:
+    //an element and everything it contains, as written at depth; the text is split at each id, so that
+    //the ids may be written afresh for each document
+    struct fragment {
+        std::vector<std::string>    text;       //before the first id, between ids and after the last
+        std::vector<std::string>    ids;        //as rendered, in document order
+        int                         depth = 0;
+        bool                        pretty = true;
+    };
+    
+    CMEISerializer(std::string& output, const bool pretty = true, const int indentation = 2);
+    
+    void                    declaration();
+    void                    open(MeiElement* element);
+    void                    close(MeiElement* element);
+    void                    write(MeiElement* element);
+    void                    stand_in(MeiElement* element, const fragment* rendered, const std::vector<std::string>* ids = NULL);
+    
+    static void             render(MeiElement* element, fragment& rendered, const bool pretty = true, const int indentation = 2, const int depth = 0);
+    static void             escape(const std::string& text, std::string& output, const bool attribute);
+
+private:
+    void                    indent();
+    void                    start_tag(MeiElement* element);
+    void                    end_line();
+    void                    splice(const fragment& rendered, const std::vector<std::string>* ids);
+    
+    struct stand_in_element {
+        MeiElement*                     element;
+        const fragment*                 rendered;
+        const std::vector<std::string>* ids;    //written in place of the ids rendered, if not NULL
+    };
+    
+    std::string&            output;
+    bool                    pretty;         //each element on a line of its own, indented by its depth
+    int                     indentation;    //spaces per level of nesting
+    int                     depth = 0;      //elements opened and not yet closed
+    std::vector<stand_in_element>   stand_ins;
+    fragment*               rendering = NULL;   //being rendered, split at each id
+    size_t                  rendered_to = 0;    //end of the output already in rendering
+};
+
+#endif /* defined(__Scribe2NeoScribe__CMEISerializer__) */
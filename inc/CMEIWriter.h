@@ -0,0 +1,232 @@
+//
+//  CMEIWriter.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  A CMEIWriter stores converted MEI files. Each output is recorded in the manifest under its location,
+//  which the writer derives from the name the converter gives it:
+//      CFileWriter     - loose files, located at their names
+//      CAtomicWriter   - loose files, each written under a temporary name and renamed into place once it is
+//                        on disk; files are synced and renamed in batches (the default)
+//      CFanOutWriter   - as CAtomicWriter, but spread over two levels of directories named from a hash of the file name
+//      CTarWriter      - members appended to one tar archive, with a table of contents beside it
+//  and CCompressingWriter compresses MEI files in a thread of its own before passing them to another writer.
+//  On Linux, CUringWriter writes loose files through io_uring in batches, under temporary names synced and renamed
+//  into place as CAtomicWriter's are (only if built with HAVE_LIBURING).
+//  A writer tells the handler given to on_stored of each file once it is completely stored at its location,
+//  which may be some time after write returns; until then, exists does not report it.
+//  A file may also be written in pieces as it is produced, with begin, append and end in place of write.
+//  CAtomicWriter, CFanOutWriter and CTarWriter store each piece as it is appended; other writers collect
+//  the pieces and write the file whole at end.
+//
+
+#ifndef __Scribe2NeoScribe__CMEIWriter__
+#define __Scribe2NeoScribe__CMEIWriter__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <exception>
+#include <functional>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "Header.h"
+
+
+class CMEIWriter {
+
+public:
+    typedef std::function<void (const std::string& location)> stored_handler;
+    
+    virtual ~CMEIWriter() {}
+    
+    virtual std::string     location(const std::string& name) const = 0;
+    virtual void            write(const std::string& location, const std::string& text) = 0;
+    virtual const bool      exists(const std::string& location) const = 0;
+    virtual void            begin(const std::string& location);
+    virtual void            append(const std::string& text);
+    virtual void            end();
+    virtual void            close() {}
+    virtual void            on_stored(const stored_handler& handler) { stored = handler; }
+    
+protected:
+    void                    notify_stored(const std::string& location) const { if (stored) stored(location); }
+    
+    stored_handler          stored;
+    
+private:
+    std::string             collected_location;     //of the file being written in pieces
+    std::string             collected_text;
+};
+
+class CFileWriter : public CMEIWriter {
+
+public:
+    std::string             location(const std::string& name) const { return name; }
+    void                    write(const std::string& location, const std::string& text);
+    const bool              exists(const std::string& location) const;
+    
+protected:
+    static std::string      temporary_name(const std::string& location);
+    static void             sync_directories(const std::vector<std::string>& locations);
+};
+
+class CAtomicWriter : public CFileWriter {
+    
+public:
+    CAtomicWriter(const size_t batch_size = 64);
+    ~CAtomicWriter();
+    
+    void                    write(const std::string& location, const std::string& text);
+    void                    begin(const std::string& location);
+    void                    append(const std::string& text);
+    void                    end();
+    void                    close();
+    
+private:
+    void                    commit();
+    void                    discard();
+    void                    abandon();
+    
+    struct staged_file {
+        std::string         location;
+        std::string         temporary;
+        int                 fd;
+    };
+    
+    size_t                  batch_size;     //files synced and renamed together
+    std::vector<staged_file>    staged;     //written under their temporary names, in order
+    staged_file             open_file = { "", "", -1 };     //being written in pieces, not yet staged
+};
+
+class CFanOutWriter : public CAtomicWriter {
+
+public:
+    CFanOutWriter(const std::string& root_directory = ".", const size_t batch_size = 64);
+    
+    std::string             location(const std::string& name) const;
+    void                    begin(const std::string& location);
+
+private:
+    std::string             root_directory;
+};
+
+class CTarWriter : public CMEIWriter {
+
+public:
+    CTarWriter(const std::string& archive_file);
+    ~CTarWriter();
+    
+    std::string             location(const std::string& name) const;
+    void                    write(const std::string& location, const std::string& text);
+    void                    begin(const std::string& location);
+    void                    append(const std::string& text);
+    void                    end();
+    const bool              exists(const std::string& location) const;
+    void                    close();
+
+private:
+    void                    open_archive();
+    std::string             member_name(const std::string& location) const;
+    void                    header(const std::string& member, const long long size, char* block) const;
+    void                    finish_member(const std::string& location, const long long size);
+    void                    abandon();
+    
+    struct toc_entry {
+        long long           offset;     //of member data within the archive
+        long long           size;
+    };
+    
+    std::string                         archive_file;
+    std::ofstream                       archive;
+    std::ofstream                       toc;
+    long long                           archive_size = 0;
+    std::map<std::string, toc_entry>    members;    //later members of the same name replace earlier ones
+    std::string                         open_location;      //being written in pieces, after a provisional header
+    long long                           open_size = 0;
+};
+
+//zstd is only available if the converter is built with HAVE_ZSTD defined and linked with libzstd
+enum compression_t { gzip_compression, zstd_compression };
+
+class CCompressingWriter : public CMEIWriter {
+    
+public:
+    CCompressingWriter(CMEIWriter* output, const compression_t method = gzip_compression, const int level = 6, const size_t queue_limit = 16);
+    ~CCompressingWriter();
+    
+    std::string             location(const std::string& name) const;
+    void                    write(const std::string& location, const std::string& text);
+    const bool              exists(const std::string& location) const;
+    void                    close();
+    void                    on_stored(const stored_handler& handler);
+    
+    static const int        max_level(const compression_t method);  //levels run from 1
+    
+private:
+    void                    run();
+    std::string             compress(const std::string& text) const;
+    void                    rethrow();
+    
+    CMEIWriter*             output;         //owned; receives compressed files
+    compression_t           method;
+    int                     level;
+    size_t                  queue_limit;    //conversion waits if this many files are waiting to be compressed
+    
+    std::deque<std::pair<std::string, std::string> >    queue;  //location and text
+    bool                    closing = false;
+    std::exception_ptr      error;          //first failure of the writer thread, reported to the converter
+    std::mutex              lock;
+    mutable std::mutex      output_lock;
+    std::condition_variable changed;
+    std::thread             worker;
+};
+
+#ifdef HAVE_LIBURING
+class CUringWriter : public CFileWriter {
+    
+public:
+    CUringWriter(const size_t batch_size = 32);
+    ~CUringWriter();
+    
+    void                    write(const std::string& location, const std::string& text);
+    void                    close();
+    
+private:
+    void                    submit();
+    void                    complete(const size_t limit);
+    const bool              finish(const uint64_t id);
+    void                    publish();
+    void                    discard();
+    
+    struct pending_write {
+        int                 fd;
+        std::string         location;
+        std::string         temporary;
+        std::string         text;           //kept until the kernel has written it
+        int                 written = 0;    //result of the write, once complete
+        int                 synced = 0;     //result of the fsync linked to it, once complete
+        int                 completions = 0;
+    };
+    
+    struct io_uring         ring;
+    bool                    ring_open = false;
+    size_t                  batch_size;     //writes queued before they are submitted together
+    size_t                  queued = 0;     //writes not yet submitted
+    uint64_t                next_write = 0;
+    std::map<uint64_t, pending_write>   writes;     //queued or in flight
+    std::vector<std::string>            renamed;    //into place, but not yet reported stored
+};
+#endif
+
+#endif /* defined(__Scribe2NeoScribe__CMEIWriter__) */
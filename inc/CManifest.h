@@ -0,0 +1,53 @@
+//
+//  CManifest.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CManifest records a fingerprint of the input of every converted Scribe file and every MEI file written,
+//  so that unchanged pieces need not be converted and written again. A manifest may be shared by several
+//  converter threads.
+//
+
+#ifndef __Scribe2NeoScribe__CManifest__
+#define __Scribe2NeoScribe__CManifest__
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include "Header.h"
+
+
+class CManifest {
+    
+public:
+    CManifest(const std::string& manifest_file);
+    ~CManifest();
+    
+    const bool              is_current(const std::string& key, const uint64_t fingerprint) const;
+    void                    update(const std::string& key, const uint64_t fingerprint, const std::string& owner = "");
+    std::vector<std::string> owned_by(const std::string& owner) const;
+    std::vector<std::string> keys() const;
+    const bool              lookup(const std::string& key, uint64_t& fingerprint, std::string& owner) const;
+    void                    save();
+    
+private:
+    void            load_manifest();
+    
+    struct manifest_entry {
+        uint64_t    fingerprint;
+        std::string owner;      //Scribe file from which an output was produced; empty for Scribe files
+    };
+    
+    std::string                             manifest_file;
+    std::map<std::string, manifest_entry>   entries; //ordered so that saved manifests are deterministic
+    bool                                    dirty = false;
+    mutable std::mutex                      lock;
+};
+
+
+#endif /* defined(__Scribe2NeoScribe__CManifest__) */
@@ -0,0 +1,166 @@
+//
+//  CMelodicIndex.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  An inverted index of the melodic intervals of a corpus, so that a melodic fragment can be found in every
+//  part of every file without reading the files again. The notes of each part - notes, the notes of ligatures
+//  and of neumes, in order, rests and other signs passed over - are reduced to the intervals between them in
+//  diatonic steps, so that a fragment is found at any transposition. Each run of gram_length intervals is an
+//  n-gram, posted with the part and note at which it starts; runs cut short by the end of a part are posted
+//  too, padded, so that every note followed by another starts one n-gram.
+//
+//  CMelodicIndexer is a consumer of CScribeTraversal that indexes the files it is given into a segment.
+//  Segments built separately, in parallel or in different runs, are merged into one, and saved as a single
+//  file that CMelodicIndex maps into memory and searches in place:
+//
+//      header | keys | key offsets | postings (part, note) | parts (file, part) | notes (row, event) | text |
+//      suffixes | LCP | file names
+//
+//  n-grams are keys of one byte per interval, first interval first, so that the n-grams beginning with a
+//  fragment shorter than gram_length are a range of keys. Longer fragments are found by intersecting the
+//  postings of their n-grams. Numbers are stored in the byte order of the machine that built the index.
+//
+//  The index also holds the intervals of every part end to end, one byte per note, as a text, with a suffix
+//  array of the text and the longest prefix each suffix has in common with the one before it (LCP). Any
+//  fragment, however long, is found by binary search of the suffix array; a fragment found nowhere whole,
+//  such as an incipit, is taken as far as it is found. The suffix array is sorted by prefix doubling, each
+//  round sorted in parallel, and is built again for an index made by merging.
+//
+
+#ifndef __Scribe2NeoScribe__CMelodicIndex__
+#define __Scribe2NeoScribe__CMelodicIndex__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Header.h"
+#include "CScribeTraversal.h"
+
+class CScribeCodes;
+
+//an n-gram starting at a note of a part; in a saved index the key is held once for all its postings
+struct melodic_posting {
+    uint32_t    key;
+    uint32_t    part;       //in the parts of the index
+    uint32_t    note;       //in the notes of the part
+};
+
+struct melodic_part {
+    uint32_t    file;       //in the files of the index
+    uint32_t    part;       //in its file, from 1
+    uint64_t    first_note; //in the notes of the index
+};
+
+struct melodic_note {
+    uint32_t    row;        //in the rows of its part, from 1
+    uint32_t    event;      //in the events of its row, from 1
+};
+
+//the index of a number of files, as built or loaded for merging
+class melodic_segment {
+
+public:
+    std::vector<std::string>        files;
+    std::vector<melodic_part>       parts;
+    std::vector<melodic_note>       notes;
+    std::vector<melodic_posting>    postings;   //by key, then part and note once sorted
+    std::vector<uint8_t>            text;       //interval from each note to the next in its part as a key byte, 0 at the last
+    std::vector<uint32_t>           suffixes;   //notes followed by another in their part, in order of the text from them on
+    std::vector<uint32_t>           lcp;        //of each suffix and the one before it, in intervals
+    
+    void            clear();
+    void            sort();
+    void            merge(std::vector<melodic_segment>& segments);
+    void            sort_suffixes(const int jobs);
+    void            save(const std::string& index_file) const;
+};
+
+
+class CMelodicIndexer : public CScribeConsumer {
+
+public:
+    static const uint32_t   gram_length = 4;    //intervals to an n-gram; one byte of a key each
+    
+    void                BeginFile(const CScribeReaderVisitable& scribe_data);
+    template <scribe_type notation>
+    void                BeginPart(const CScribeReaderVisitable&, const scribe_part& part) { IndexPart(part); }
+    template <scribe_type notation>
+    void                Row(const scribe_row&) { row_number++; event_number = 0; }
+    template <scribe_type notation>
+    void                Event(const scribe_event& event) { IndexEvent(event); }
+    template <scribe_type notation>
+    void                EndPart(const scribe_part&) { PostGrams(); }
+    
+    melodic_segment&    Segment() { return segment; }
+    
+    static void         Build(const std::vector<std::string>& files, const int jobs, melodic_segment& index);
+
+private:
+    void                IndexPart(const scribe_part& part);
+    void                IndexEvent(const scribe_event& event);
+    void                PostGrams();
+    
+    melodic_segment             segment;
+    const CScribeCodes*         codes = NULL;           //of the file being indexed
+    const scribe_part*          current_part = NULL;
+    uint32_t                    part_number = 0;        //of the part being indexed, in its file
+    uint32_t                    row_number = 0;
+    uint32_t                    event_number = 0;
+    std::vector<int>            steps;                  //diatonic pitch of each note of the part being indexed
+};
+
+
+class CMelodicIndex {
+
+public:
+    CMelodicIndex(const std::string& index_file);
+    ~CMelodicIndex();
+    
+    CMelodicIndex(const CMelodicIndex&) = delete;
+    CMelodicIndex& operator=(const CMelodicIndex&) = delete;
+    
+    void                Find(const std::vector<int>& intervals, std::vector<melodic_posting>& hits) const;
+    size_t              Match(const std::vector<int>& intervals, std::vector<melodic_posting>& hits) const;
+    void                Load(melodic_segment& segment) const;
+    
+    const std::string   FileName(const uint32_t file) const;
+    const melodic_part& Part(const uint32_t part) const { return parts[part]; }
+    const melodic_note& Note(const melodic_posting& hit) const { return notes[parts[hit.part].first_note + hit.note]; }
+    const uint64_t      FileCount() const { return file_count; }
+    const uint64_t      NoteCount() const { return note_count; }
+    
+    static void         ParseFragment(const std::string& fragment, std::vector<int>& intervals);
+
+private:
+    struct posting {
+        uint32_t        part;
+        uint32_t        note;
+    };
+    
+    void                KeyRange(const uint32_t first_key, const uint32_t last_key, size_t& first, size_t& last) const;
+    size_t              Common(const uint32_t suffix, const uint8_t* fragment, const size_t length, size_t common) const;
+    const bool          Consistent(const uint64_t names_size) const;
+    
+    std::string             index_file;
+    void*                   mapping = NULL;
+    size_t                  mapping_size = 0;
+    uint32_t                gram_length = 0;
+    uint64_t                file_count = 0, part_count = 0, note_count = 0, key_count = 0, posting_count = 0, suffix_count = 0;
+    const uint32_t*         keys = NULL;
+    const uint32_t*         offsets = NULL;     //of the first posting of each key, and one past the last
+    const posting*          postings = NULL;
+    const melodic_part*     parts = NULL;
+    const melodic_note*     notes = NULL;
+    const uint8_t*          text = NULL;
+    const uint32_t*         suffixes = NULL;
+    const uint32_t*         lcp = NULL;
+    const uint64_t*         name_offsets = NULL;
+    const char*             names = NULL;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CMelodicIndex__) */
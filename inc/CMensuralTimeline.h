@@ -0,0 +1,91 @@
+//
+//  CMensuralTimeline.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CMensuralTimeline gives each event of each part of a trecento piece an onset and a duration, and merges
+//  the parts of the piece into a single stream of events in order of time, so that the cantus, tenor and
+//  contratenor may be aligned. Times are counted in ticks, ticks_per_breve to the breve, so that the values
+//  of the duration column of the code table - halves down to the semifusa, thirds of the semibreve - are
+//  whole numbers. Notes take the duration of their code, each note of a ligature that of the longa, brevis
+//  or semibrevis at its position, and rests that of their code or, for the generic rest, of the rest its
+//  span on the staff stands for. Other events take no time. Mensuration and coloration are not applied.
+//
+//  It is a consumer of CScribeTraversal, so the events are timed as the file is converted. Each piece is
+//  written, once merged, as tab delimited rows: Scribe file, REPNUM, onset, duration, part, voice, code, pitch
+//
+
+#ifndef __Scribe2NeoScribe__CMensuralTimeline__
+#define __Scribe2NeoScribe__CMensuralTimeline__
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Header.h"
+#include "CScribeTraversal.h"
+
+class CScribeCodes;
+
+//the timed events of a part, in flat arrays of one entry for each note, rest or other event, in order
+struct part_timeline {
+    const scribe_part*                  part = NULL;
+    std::vector<const scribe_event*>    events;     //of the part, in order
+    std::vector<int64_t>                onset;      //in ticks from the start of the piece
+    std::vector<int32_t>                duration;   //in ticks
+    std::vector<uint32_t>               event;      //index in events
+    std::vector<int32_t>                pitch;      //index in the pitches of the part; -1 for a rest or event without pitch
+    
+    void            clear();
+    void            add(const int64_t at, const int32_t ticks, const uint32_t event_index, const int32_t pitch_index);
+};
+
+
+class CMensuralTimeline : public CScribeConsumer {
+    
+public:
+    static const int32_t    ticks_per_breve = 1152; //2^7 * 3^2
+    
+    CMensuralTimeline(const std::string& timeline_file);
+    
+    void                BeginFile(const CScribeReaderVisitable& scribe_data);
+    template <scribe_type notation>
+    void                BeginPart(const CScribeReaderVisitable&, const scribe_part& part) { if (notation == trecento) TimePart(part); }
+    template <scribe_type notation>
+    void                Event(const scribe_event& event) { if (notation == trecento) TimeEvent(event); }
+    void                EndFile(const CScribeReaderVisitable& scribe_data);
+    
+    const long long     PieceCount() const { return pieces; }
+    const long long     EntryCount() const { return entries; }
+    
+    static void         Merge(const std::vector<part_timeline>& parts, const size_t part_count, std::vector<std::pair<uint32_t, uint32_t> >& order);
+    
+private:
+    struct code_timing {
+        code_t          type;
+        int32_t         ticks;
+    };
+    
+    void                TimePart(const scribe_part& part);
+    void                TimeEvent(const scribe_event& event);
+    void                EndPiece();
+    const code_timing&  timing(const std::string& code);
+    
+    std::string                 timeline_file;
+    std::ofstream               output;
+    std::string                 source;             //Scribe file being timed
+    const CScribeCodes*         codes = NULL;       //of the file being timed
+    std::unordered_map<std::string, code_timing>    timings;    //by code, as found
+    std::vector<part_timeline>  parts;              //of the piece being timed; kept between pieces for their capacity
+    size_t                      part_count = 0;     //parts of the piece being timed
+    int64_t                     now = 0;            //onset of the next event of the part being timed
+    std::vector<std::pair<uint32_t, uint32_t> >     order;      //part and entry of each event of the piece, in order of time
+    long long                   pieces = 0;
+    long long                   entries = 0;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CMensuralTimeline__) */
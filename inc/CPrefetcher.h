@@ -0,0 +1,82 @@
+//
+//  CPrefetcher.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CPrefetcher reads the Scribe files of a batch, in order, ahead of their conversion:
+//      blocking_io     - each file is read when it is asked for (no read ahead)
+//      threaded_io     - a thread reads up to depth files ahead of conversion
+//      uring_io        - reads of up to depth files are submitted to io_uring together (Linux, HAVE_LIBURING)
+//  Without HAVE_LIBURING, uring_io falls back to threaded_io.
+//
+
+#ifndef __Scribe2NeoScribe__CPrefetcher__
+#define __Scribe2NeoScribe__CPrefetcher__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "Header.h"
+
+
+enum io_backend_t { blocking_io, threaded_io, uring_io };
+
+struct prefetched_file {
+    std::string     name;
+    std::string     contents;       //as stored, ie. still compressed if the file is
+    bool            found = false;  //false if the file could not be read
+};
+
+class CPrefetcher {
+
+public:
+    CPrefetcher(const std::vector<std::string>& files, const io_backend_t backend = blocking_io, const size_t depth = 32);
+    ~CPrefetcher();
+    
+    bool                    next(prefetched_file& file);
+    const io_backend_t      backend() const { return io; }
+
+private:
+    static bool             read_file(prefetched_file& file);
+    void                    run();
+#ifdef HAVE_LIBURING
+    void                    submit_reads();
+    void                    complete_read();
+#endif
+    
+    std::vector<std::string>    files;
+    io_backend_t            io;
+    size_t                  depth;          //files read ahead of conversion
+    size_t                  next_file = 0;  //next to be handed out
+    size_t                  next_read = 0;  //next to be read
+    std::deque<prefetched_file> ready;      //files next_file onwards that have been read, in order
+    
+    //threaded_io
+    bool                    stopping = false;
+    std::mutex              lock;
+    std::condition_variable changed;
+    std::thread             reader;
+
+#ifdef HAVE_LIBURING
+    struct pending_read {
+        int                 fd;
+        size_t              done;           //bytes read so far
+    };
+    
+    struct io_uring         ring;
+    std::deque<pending_read>    pending;    //one per file in ready, in the same order
+    size_t                  in_flight = 0;
+#endif
+};
+
+#endif /* defined(__Scribe2NeoScribe__CPrefetcher__) */
@@ -24,11 +24,12 @@ public:
                     CScribeCodes(const CScribeCodes &codes);
                     ~CScribeCodes();
     
-    const std::string&    code_to_name(const std::string code) const;
+    const std::string&    code_to_name(const std::string& code) const;
     const bool      contains_code(const std::string& code) const;
     const bool      is_pitched_code(const std::string& code) const;
     const bool      is_ligature(const std::string& code) const;
     const code_t    get_code_type(const std::string& code) const;
+    const double    duration(const std::string& code) const;
     
     CScribeCodes&   operator=(const CScribeCodes& rhs);
     
@@ -39,6 +40,7 @@ private:
     std::vector<std::vector<std::string> >          code_matrix;
     std::unordered_map<std::string, std::string>    code_name_map;
     std::unordered_map<std::string, bool>           code_pitchcode_map;
+    std::unordered_map<std::string, double>         code_duration_map;  //in breves
     std::multimap<std::string, std::string>         code_types;
     
 };
@@ -18,9 +18,10 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <utility>
 
 #include "Header.h"
-#include "Visitor.h"
+#include "CVisitor.h"
 
 class CScribeCodes; //forward declaration
 
@@ -35,6 +36,16 @@ public:
     const int  get_octave(const int pitch_loc);
 };
 
+//pitch of a number of an event, as exporters name it under the clef in force where the event is read
+struct scribe_pitch {
+    char        name;           //'a' to 'g'
+    int         octave;         //ASA, middle c = 4
+    char        clef;           //clef in force, and its line as numbered in Scribe
+    int         clef_line;
+    
+    const int   diatonic() const { return 7 * octave + (name - 'c' + 7) % 7; } //steps above c0
+};
+
 class scribe_staff_data
 {
 public:
@@ -56,8 +67,9 @@ public:
     bool                preceding_gap = true;
     coloration_type     local_coloration = full_black;
     std::vector<int>    pitch_num;
+    size_t              first_pitch = 0;    //index of the pitch of pitch_num[0] in the pitches of its part
     
-    void            clear() { code.clear(); preceding_gap = true; local_coloration = full_black; pitch_num.clear(); }
+    void            clear() { code.clear(); preceding_gap = true; local_coloration = full_black; pitch_num.clear(); first_pitch = 0; }
 };
 
 //A scribe row/line may contain several events, but only one syllable (although compound syllables also occur).
@@ -76,6 +88,7 @@ struct scribe_row {
     std::string                 comment;
     bool                        is_comment = false;
     scribe_staff_data           suffix;
+    std::vector<std::pair<size_t, size_t> > neume_groups;   //first and one past the last event of each compound neume, in order
 };
 
 
@@ -100,19 +113,25 @@ public:
     std::string office;             //chant only
     int         cao_num = 0;        //chant only
     std::vector<scribe_row>  rows; //common
+    std::vector<scribe_pitch> pitches; //common - one for each number of each event of rows, in order
     
     int         partID = 0;
     
     scribe_staff_data   initial_staff_data;
     bool        initial_staff_data_set = false;
+    
+    //location and hash of the part's bytes in the Scribe file; used by Reload to skip unchanged parts
+    size_t      byte_offset = 0;
+    size_t      byte_length = 0;
+    uint64_t    content_hash = 0;
+    bool        modified = true;        //false if part was reused unchanged from a previous load
 };
 
-class CScribeReaderVisitable : public Loki::BaseVisitable<>
+class CScribeReaderVisitable : public CVisitable<CScribeReaderVisitable> //Accept calls the Visit(CScribeReaderVisitable&) of any visitor, resolved at compile time
 {
 public:
-    LOKI_DEFINE_VISITABLE() //adds Accept call to BaseVisitor; must call CScribeReaderVisitable::accept with a class inheriting from BaseVisitor;
-        
     CScribeReaderVisitable(const std::string& scribe_file_name);
+    CScribeReaderVisitable(const std::string& scribe_file_name, std::string& contents);
     ~CScribeReaderVisitable();
     
     const bool                 is_scribe_file() const { return (type==chant || type==trecento); }
@@ -120,25 +139,48 @@ public:
     const std::vector<scribe_part>& GetScribeParts() const { return parts; }
     static const std::string   get_ineume_part(const std::string& code, const int i, int& neume_notes);
     static std::vector<int>    get_pitch_code(char& c, std::stringstream& lineStream);
-    std::string                get_ligature_part(const std::string& code, const int note_count) const;
+    const std::string&         get_ligature_part(const std::string& code, const int note_count) const;
+    static const std::string&  get_ligature_code(const std::string& code, const int note_count);
     const scribe_type          GetType() const { return type; }
     const CScribeCodes*        GetCodes() const { return codes; }
     const int                  PieceCount() const {return pieceCount; }
+    const std::string&         GetFileName() const { return file_name; }
+    const uint64_t             GetContentHash() const { return content_hash; }
+    const std::vector<int>&    Reload();
+    const std::vector<int>&    ChangedParts() const { return changed_parts; }
     
 private:
     
-    scribe_type         read_header();
-    int                 load_scribe_file();
+    enum file_compression_t { no_compression, gzip_compressed, zstd_compressed };
+    
+    bool                read_scribe_buffer();
+    void                read_scribe_buffer(std::string& contents);
+    static file_compression_t compression_of(const char* start, const size_t length);
+    void                decompress(std::istream& file, const file_compression_t compression);
+    void                inflate_gzip(std::istream& file);
+    void                decompress_zstd(std::istream& file);
+    scribe_type         read_header(std::istream& in);
+    int                 load_scribe_file(const bool reuse_parts, const scribe_type notation);
+    template <scribe_type notation>
+    int                 load_scribe_file(const bool reuse_parts);
+    template <scribe_type notation>
+    void                read_scribe_part(std::istream& in, scribe_part& part);
+    template <scribe_type notation>
+    void                read_part_header(const std::string& row, scribe_part& part);
     std::string         read_part_header_field(const std::string& row, std::streampos& start, const size_t field_length);
     scribe_row          read_scribe_row(std::string raw_row);
+    void                resolve_pitches(scribe_part& part) const;
     scribe_type         file_type() { return type; }
     
     const        CScribeCodes*       trecento_codes;
     const        CScribeCodes*       chant_codes;
     const        CScribeCodes*       codes;
-    std::ifstream       file;
+    std::string         file_name;
+    std::string         buffer; //raw contents of the Scribe file, decompressed if necessary
+    uint64_t            content_hash = 0; //hash of the file as stored, before any decompression
     scribe_type         type;
     std::vector<scribe_part>   parts; //all voices or parts
+    std::vector<int>    changed_parts; //partIDs reparsed by the last load
     int                 pieceCount = 0;
 };
 
@@ -13,44 +13,180 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
 #include <mei/mei.h>
 #include <mei/header.h>
 #include <mei/shared.h>
 
-#include "Visitor.h"
 #include "CSourceKey.h"
+#include "CManifest.h"
+#include "CJournal.h"
+#include "CCatalogue.h"
+#include "CMEIWriter.h"
+#include "CMEISerializer.h"
+#include "CScribeTraversal.h"
 
-using namespace Loki;
 using namespace mei;
 
-class CScribeReaderVisitable;
-class scribe_part;
 
-class CScribeToNeoScribeXML : public BaseVisitor, public Visitor<CScribeReaderVisitable>
+//a consumer of CScribeTraversal, building the MEI of each piece as its parts are traversed
+class CScribeToNeoScribeXML : public CScribeConsumer
 {
 public:
     CScribeToNeoScribeXML(const std::string& encoder_name);
+    CScribeToNeoScribeXML(const std::string& encoder_name, CManifest* shared_manifest);
     ~CScribeToNeoScribeXML();
     
     void                PrintMEIXML(const std::string& encoder_name="John A. Stinson");
     void                SaveMEIXML(const std::string& file_name, const std::string& encoder_name="John A. Stinson");
     void                SegmentScribe2MEIXML(const CScribeReaderVisitable& scribe_data);
+    int                 ConvertScribeFile(CScribeReaderVisitable& scribe_data);
+    const bool          IsCurrent(const std::string& scribe_file);
+    const bool          IsCurrent(const std::string& scribe_file, const uint64_t content_hash);
+    void                SetForceConversion(const bool force_conversion) { force = force_conversion; }
+    void                SetJournal(CJournal* batch_journal) { journal = batch_journal; }
+    void                SetDeterministicIds(const bool counter_ids);
+    void                SetCompact(const bool compact_profile);
+    void                SetWriter(CMEIWriter* output_writer);
+    void                SetShard(const int index, const int count, const std::string& directory);
+    void                SetCatalogue(CCatalogue* piece_catalogue) { catalogue = piece_catalogue; }
+    void                SetStreaming(const bool stream_sections) { streaming = stream_sections; }
     
     void                Visit(CScribeReaderVisitable& scribe_data);
     
+    //CScribeTraversal hooks
+    void                BeginFile(const CScribeReaderVisitable& scribe_data);
+    template <scribe_type notation>
+    void                BeginPart(const CScribeReaderVisitable& scribe_data, const scribe_part& partit);
+    template <scribe_type notation>
+    void                Row(const scribe_row& row);
+    template <scribe_type notation>
+    void                Event(const scribe_event& event);
+    template <scribe_type notation>
+    void                EndPart(const scribe_part& partit);
+    void                EndFile(const CScribeReaderVisitable& scribe_data);
+    
 private:
     
+    //kinds of element to which the notes of an event are added
+    enum container_t { syllable_container, uneume_container, ineume_container, ligature_container };
+    
+    //a piece to be converted as the parts of a file are traversed
+    struct piece_plan {
+        std::vector<scribe_part>::const_iterator    first, last;
+        int             first_number;               //number of the staff of the first part
+        bool            segmented;                  //one of several pieces of its file
+        std::string     file_name;                  //MEI file to write; empty if the caller saves the document
+        uint64_t        fingerprint;
+    };
+    
     std::string         encoder = "Unknown";
     CSourceKey*         sourcekey;
+    CManifest*          manifest;
+    bool                owns_manifest = true;
+    CMEIWriter*         writer;                     //stores MEI files; loose files, renamed into place, unless set otherwise
+    bool                owns_writer = true;
+    CJournal*           journal = NULL;             //checkpoint journal of a batch conversion, owned by the caller
+    uint64_t            conversion_seed;            //hash of code tables, source key, converter version and encoder
+    uint64_t            doc_fingerprint = 0;        //fingerprint of the input of doc
+    std::string         current_source;             //Scribe file being converted
+    uint64_t            current_source_hash = 0;
+    bool                force = false;              //convert and write even if output is current
+    bool                deterministic_ids = false;  //replace generated ids with ids counted in document order
+    bool                compact = false;            //unindented, without placeholders or attributes given by staff defaults
+    int                 shard_index = 0;            //convert only pieces hashed to shard_index of shard_count
+    int                 shard_count = 1;
+    std::string         output_directory;           //directory of MEI files of a shard; empty for the current directory
+    CCatalogue*         catalogue = NULL;           //catalogue of pieces converted, owned by the caller
+    bool                streaming = false;          //write each section as soon as it is built, then delete it
+    CMEISerializer*     stream = NULL;              //writes the piece being streamed to stream_text
+    std::string         stream_text;                //handed to the writer after each section, unless stream_location is empty
+    std::string         stream_location;            //MEI file of the piece being streamed; empty if it is saved by the caller
+    MeiElement*         stream_score = NULL;        //innermost element left open while sections are written
+    int                 stream_count = 0;           //ids assigned so far to the piece being streamed
+    int                 stream_staff_count = 0;
+    
+    //state of the traversal of the file being converted
+    const CScribeReaderVisitable*   current_data = NULL;
+    std::vector<piece_plan>         pieces;         //pieces of the file to convert, in order
+    size_t              next_piece = 0;             //piece begun or next to begin
+    bool                commit_source = false;      //commit the Scribe file once traversed
+    Score*              piece_score = NULL;         //score of the piece being built; NULL between pieces
+    StaffGrp*           piece_staffgrp = NULL;
+    int                 staff_number = 0;           //number of the staff being built within its piece
+    Staff*              current_staff = NULL;
+    StaffDef*           current_staffdef = NULL;    //NULL if made before the staff, when streaming
+    Syllable*           current_syllable = NULL;    //NULL in a comment row
+    const scribe_row*   current_row = NULL;
+    size_t              event_index = 0;            //of the event being converted within current_row
+    size_t              next_group = 0;             //first compound neume of current_row not yet passed
+    Ineume*             current_ineume = NULL;      //last ineume of current_syllable
+    const scribe_part*  current_part = NULL;
+    coloration_type     current_color = coloration_type::full_black;
     
+    //MEI files are journalled once the writer has stored them, and Scribe files once all their MEI files are stored
+    std::mutex          storage_lock;               //writers may report files stored from a thread of their own
+    std::map<std::string, std::deque<std::pair<uint64_t, std::string> > >   unstored;   //fingerprint and owner of each write, in order
+    std::map<std::string, int>      unstored_count; //by owning Scribe file
+    std::map<std::string, uint64_t> waiting_sources;    //Scribe files committed, with their fingerprints, whose MEI files are not all stored
+    
+    void                InitConversionSeed();
+    void                NewMEIDocument();
+    void                WriteMEIXML(const std::string& file_name);
+    void                AssignIds(MeiElement* root, int& count, int& staff_count);
+    void                BeginStream(std::vector<scribe_part>::const_iterator first, std::vector<scribe_part>::const_iterator last, const int first_number, Score* score, StaffGrp* staffgrp, const std::string& file_name);
+    void                FlushStream();
+    void                EndStream();
+    void                PlanSegments(const CScribeReaderVisitable& scribe_data);
+    void                BeginPiece(const piece_plan& piece);
+    void                EndPiece(const piece_plan& piece);
+    void                Commit(const std::string& key, const uint64_t fingerprint, const std::string& owner = "");
+    void                AwaitStorage(const std::string& file_name, const uint64_t fingerprint, const std::string& owner);
+    void                Stored(const std::string& file_name);
+    const bool          InShard(const std::string& xml_file_name) const;
+    std::string         OutputPath(const std::string& xml_file_name) const;
+    uint64_t            SourceFingerprint(const uint64_t content_hash) const;
+    uint64_t            PieceFingerprint(std::vector<scribe_part>::const_iterator first, std::vector<scribe_part>::const_iterator last) const;
+    const bool          OutputIsCurrent(const std::string& file_name, const uint64_t fingerprint, const bool written_in_run = false) const;
     MeiDocument*        Scribe2MEIXML(const CScribeReaderVisitable& scribe_data);
     void                Scribe2MEIXMLFileData(FileDesc* fileDesc, const scribe_part& partit );
     void                Scribe2MEIXMLWorkData(WorkDesc* workDesc, const scribe_part& partit );
     FileDesc*           Scribe2MEIFileDesc();
+    PubStmt*            Scribe2MEIPubStmt();
     EncodingDesc*       Scribe2MEIEncoderDesc();
     WorkDesc*           Scribe2MEIWorkDesc();
     Score*              Scribe2MEIXMLScore();
-    Staff*              Scribe2MEIXMLStaff(const CScribeReaderVisitable& scribe_data, const scribe_part& partit, StaffGrp* staffgrp, const int i);
+    void                AddColoration(MeiElement* element, const coloration_type color) const;
+    template <scribe_type notation>
+    void                Scribe2MEIXMLNotes(const CScribeReaderVisitable& scribe_data, const scribe_event& event, MeiElement* foster, const container_t container, const coloration_type color, const scribe_pitch* pitches);
+    StaffDef*           Scribe2MEIXMLStaffDef(const scribe_part& partit, const int i);
+    void                SetStaffDefaults(StaffDef* staffdef, Staff* staff) const;
+    
+    //parts of the MEI header that are the same for every piece are rendered once, and each document holds
+    //childless stand-ins in their place
+    struct header_template {
+        CMEISerializer::fragment    rendered;
+        std::vector<bool>           numbered;       //whether AssignIds numbers each id of the fragment
+    };
+    struct header_stand_in {
+        MeiElement*                 element;
+        const header_template*      part;
+        std::vector<std::string>    ids;            //numbered in document order; empty if the ids rendered are kept
+    };
+    
+    void                RenderHeaderTemplates();
+    static void         RenderHeaderTemplate(MeiElement* element, const int depth, const bool pretty, header_template& part);
+    void                StandIn(MeiElement* element, const header_template& part);
+    header_stand_in*    FindStandIn(MeiElement* element);
+    void                SpliceHeader(CMEISerializer& serializer) const;
+    static const bool   KeepsId(MeiElement* element);
+    
+    header_template     pubstmt_template;
+    header_template     encodingdesc_template;
+    std::vector<header_stand_in>    header_stand_ins;   //of the current document
     
     MeiDocument*      doc;
 };
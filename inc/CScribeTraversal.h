@@ -0,0 +1,171 @@
+//
+//  CScribeTraversal.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CScribeTraversal drives any number of consumers through the parts, rows and events of Scribe data in a
+//  single pass, so that the outputs of a file - its MEI, its statistics - are made while each row is at hand
+//  rather than by walking the file once for each. At each step the consumers are called in the order given:
+//
+//      BeginFile(scribe_data)
+//          BeginPart<notation>(scribe_data, part)      for each part
+//              Row<notation>(row)                      for each row of the part
+//                  Event<notation>(event)              for each event of the row
+//          EndPart<notation>(part)
+//      EndFile(scribe_data)
+//
+//  where notation, chant or trecento, is chosen once per file. A consumer derives from CScribeConsumer and
+//  hides the hooks it needs; calls are resolved at compile time, and each consumer keeps its own state.
+//
+//      CScribeTraversal<CScribeToNeoScribeXML, CStatistics> pass(nsXML, statistics);
+//      scribe_data.Accept(pass);
+//
+//  A consumer wanted only in some runs is wrapped in COptionalConsumer, which passes nothing on if not given.
+//
+
+#ifndef __Scribe2NeoScribe__CScribeTraversal__
+#define __Scribe2NeoScribe__CScribeTraversal__
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "Header.h"
+#include "CScribeReaderVisitable.h"
+
+
+class CScribeConsumer {
+
+public:
+    void                BeginFile(const CScribeReaderVisitable&) {}
+    template <scribe_type notation>
+    void                BeginPart(const CScribeReaderVisitable&, const scribe_part&) {}
+    template <scribe_type notation>
+    void                Row(const scribe_row&) {}
+    template <scribe_type notation>
+    void                Event(const scribe_event&) {}
+    template <scribe_type notation>
+    void                EndPart(const scribe_part&) {}
+    void                EndFile(const CScribeReaderVisitable&) {}
+
+protected:
+    ~CScribeConsumer() {}   //not deleted through this class
+};
+
+//a consumer chosen at run time, such as statistics asked for by a parameter: its hooks are passed on
+//only if it is given, so that one traversal serves whichever consumers a batch uses
+template <class Consumer>
+class COptionalConsumer : public CScribeConsumer {
+
+public:
+    COptionalConsumer(Consumer* consumer = NULL) : consumer(consumer) {}
+    
+    void                BeginFile(const CScribeReaderVisitable& scribe_data) { if (consumer) consumer->BeginFile(scribe_data); }
+    template <scribe_type notation>
+    void                BeginPart(const CScribeReaderVisitable& scribe_data, const scribe_part& part) { if (consumer) consumer->template BeginPart<notation>(scribe_data, part); }
+    template <scribe_type notation>
+    void                Row(const scribe_row& row) { if (consumer) consumer->template Row<notation>(row); }
+    template <scribe_type notation>
+    void                Event(const scribe_event& event) { if (consumer) consumer->template Event<notation>(event); }
+    template <scribe_type notation>
+    void                EndPart(const scribe_part& part) { if (consumer) consumer->template EndPart<notation>(part); }
+    void                EndFile(const CScribeReaderVisitable& scribe_data) { if (consumer) consumer->EndFile(scribe_data); }
+
+private:
+    Consumer*           consumer;
+};
+
+template <class... Consumers>
+class CScribeTraversal {
+
+public:
+    CScribeTraversal(Consumers&... consumers) : consumers(consumers...) {}
+    
+    void                Visit(const CScribeReaderVisitable& scribe_data)
+    {
+        each(begin_file { scribe_data });
+        walk(scribe_data);
+        each(end_file { scribe_data });
+    }
+    
+    //the parts of a file, without BeginFile and EndFile
+    void                walk(const CScribeReaderVisitable& scribe_data)
+    {
+        if (scribe_data.GetType() == chant) walk<chant>(scribe_data);
+        else walk<trecento>(scribe_data);
+    }
+
+private:
+    template <scribe_type notation>
+    void                walk(const CScribeReaderVisitable& scribe_data)
+    {
+        for (std::vector<scribe_part>::const_iterator part = scribe_data.GetScribeParts().begin(); part != scribe_data.GetScribeParts().end(); part++)
+        {
+            each(begin_part<notation> { scribe_data, *part });
+            
+            for (std::vector<scribe_row>::const_iterator row = part->rows.begin(); row != part->rows.end(); row++)
+            {
+                each(row_of<notation> { *row });
+                
+                for (std::vector<scribe_event>::const_iterator event = row->events.begin(); event != row->events.end(); event++)
+                    each(event_of<notation> { *event });
+            }
+            
+            each(end_part<notation> { *part });
+        }
+    }
+    
+    //each hook calls one function of a consumer
+    struct begin_file {
+        const CScribeReaderVisitable&   scribe_data;
+        template <class Consumer> void  operator()(Consumer& consumer) const { consumer.BeginFile(scribe_data); }
+    };
+    
+    template <scribe_type notation>
+    struct begin_part {
+        const CScribeReaderVisitable&   scribe_data;
+        const scribe_part&              part;
+        template <class Consumer> void  operator()(Consumer& consumer) const { consumer.template BeginPart<notation>(scribe_data, part); }
+    };
+    
+    template <scribe_type notation>
+    struct row_of {
+        const scribe_row&               row;
+        template <class Consumer> void  operator()(Consumer& consumer) const { consumer.template Row<notation>(row); }
+    };
+    
+    template <scribe_type notation>
+    struct event_of {
+        const scribe_event&             event;
+        template <class Consumer> void  operator()(Consumer& consumer) const { consumer.template Event<notation>(event); }
+    };
+    
+    template <scribe_type notation>
+    struct end_part {
+        const scribe_part&              part;
+        template <class Consumer> void  operator()(Consumer& consumer) const { consumer.template EndPart<notation>(part); }
+    };
+    
+    struct end_file {
+        const CScribeReaderVisitable&   scribe_data;
+        template <class Consumer> void  operator()(Consumer& consumer) const { consumer.EndFile(scribe_data); }
+    };
+    
+    //calls hook with each consumer in turn
+    template <size_t I = 0, class Hook>
+    typename std::enable_if<(I < sizeof...(Consumers))>::type each(const Hook& hook)
+    {
+        hook(std::get<I>(consumers));
+        each<I + 1>(hook);
+    }
+    
+    template <size_t I = 0, class Hook>
+    typename std::enable_if<(I == sizeof...(Consumers))>::type each(const Hook&) {}
+    
+    std::tuple<Consumers&...>   consumers;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CScribeTraversal__) */
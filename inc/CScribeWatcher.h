@@ -0,0 +1,74 @@
+//
+//  CScribeWatcher.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CScribeWatcher watches a directory of Scribe files and reconverts each file shortly after it has been
+//  changed. Files are converted by a pool of worker threads; each file keeps its parsed model between
+//  changes so that only modified parts are reparsed and only modified pieces are written.
+//
+
+#ifndef __Scribe2NeoScribe__CScribeWatcher__
+#define __Scribe2NeoScribe__CScribeWatcher__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include "Header.h"
+
+class CManifest;
+class CScribeReaderVisitable;
+
+class CScribeWatcher {
+    
+public:
+    CScribeWatcher(const std::string& directory, const std::string& encoder_name, const int workers = 2, const int debounce_ms = 500);
+    ~CScribeWatcher();
+    
+    void                Run(); //does not return
+    
+private:
+    typedef std::chrono::steady_clock   watch_clock;
+    
+    void                WatchEvents();
+    void                ScanDirectory(std::map<std::string, time_t>* modified_times);
+    void                Rescan();
+    void                Touch(const std::string& file_name);
+    void                Forget(const std::string& file_name);
+    void                QueueSettled();
+    void                Queue(const std::string& file_name);
+    void                Worker();
+    void                Convert(const std::string& file_name);
+    static const bool   IsScribeFile(const std::string& file_name);
+    static const bool   Exists(const std::string& file_name);
+    
+    std::string         directory;
+    std::string         encoder;
+    int                 worker_count;
+    std::chrono::milliseconds   debounce;
+    CManifest*          manifest;
+    
+    std::map<std::string, watch_clock::time_point>  pending;    //changed files waiting for events to settle
+    std::deque<std::string>     queue;                          //files ready for conversion
+    std::set<std::string>       queued;
+    std::set<std::string>       converting;
+    std::set<std::string>       changed_while_converting;
+    std::map<std::string, std::shared_ptr<CScribeReaderVisitable> > readers; //parsed model kept per file
+    std::mutex                  queue_lock;
+    std::mutex                  reader_lock;
+    std::condition_variable     queue_ready;
+    std::vector<std::thread>    workers;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CScribeWatcher__) */
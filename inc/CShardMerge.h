@@ -0,0 +1,34 @@
+//
+//  CShardMerge.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CShardMerge combines the results of a corpus converted in shards, by several processes or machines,
+//  into the current directory: MEI files are moved out of the shard directories, and the shard manifests
+//  and catalogues are merged. The result does not depend on the order in which shards are given.
+//
+
+#ifndef __Scribe2NeoScribe__CShardMerge__
+#define __Scribe2NeoScribe__CShardMerge__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Header.h"
+
+
+class CShardMerge {
+    
+public:
+    CShardMerge(const std::vector<std::string>& shard_directories);
+    
+    int                         Run();
+    
+private:
+    std::vector<std::string>    shard_directories;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CShardMerge__) */
@@ -0,0 +1,59 @@
+//
+//  CStatistics.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  CStatistics counts the parts, rows and events of the Scribe files of a batch, by kind of event, and the
+//  range of their pitch codes. It is a consumer of CScribeTraversal, so it is given each row as the file
+//  is converted rather than walking the file again:
+//
+//      CScribeTraversal<CScribeToNeoScribeXML, CStatistics> pass(nsXML, statistics);
+//      scribe_data.Accept(pass);
+//      statistics.Print(std::cout);
+//
+
+#ifndef __Scribe2NeoScribe__CStatistics__
+#define __Scribe2NeoScribe__CStatistics__
+
+#include <iostream>
+#include <climits>
+
+#include "Header.h"
+#include "CScribeTraversal.h"
+
+class CScribeCodes;
+
+
+class CStatistics : public CScribeConsumer {
+    
+public:
+    void                BeginFile(const CScribeReaderVisitable& scribe_data);
+    template <scribe_type notation>
+    void                BeginPart(const CScribeReaderVisitable&, const scribe_part&) { parts++; }
+    template <scribe_type notation>
+    void                Row(const scribe_row& row) { CountRow(row); }
+    template <scribe_type notation>
+    void                Event(const scribe_event& event) { CountEvent(event); }
+    
+    void                Print(std::ostream& out) const;
+    
+private:
+    void                CountRow(const scribe_row& row);
+    void                CountEvent(const scribe_event& event);
+    
+    const CScribeCodes* codes = NULL;           //codes of the file being counted
+    long long           files = 0;
+    long long           parts = 0;
+    long long           rows = 0;
+    long long           comments = 0;
+    long long           syllables = 0;          //rows with text
+    long long           events = 0;
+    long long           events_of_type[code_t::other + 1] = {};
+    long long           pitches = 0;
+    int                 lowest_pitch = INT_MAX; //pitch codes, as numbered in Scribe
+    int                 highest_pitch = INT_MIN;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CStatistics__) */
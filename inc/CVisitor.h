@@ -0,0 +1,64 @@
+//
+//  CVisitor.h
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  Visitors resolved at compile time, in place of Loki's acyclic visitors, which find the visitor of each
+//  Accept with a dynamic_cast. A visitable class derives from CVisitable, naming itself:
+//
+//      class CScribeReaderVisitable : public CVisitable<CScribeReaderVisitable>
+//
+//  and any class with a member Visit(CScribeReaderVisitable&) may then visit it, without a common base
+//  class or virtual calls. Several visitors may visit in turn through CVisitors, each walking the data
+//  itself; consumers of the rows of Scribe data share a single walk through CScribeTraversal instead.
+//
+
+#ifndef __Scribe2NeoScribe__CVisitor__
+#define __Scribe2NeoScribe__CVisitor__
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+
+
+template <class Visited>
+class CVisitable {
+
+public:
+    template <class Visitor>
+    void                Accept(Visitor& visitor) { visitor.Visit(static_cast<Visited&>(*this)); }
+    
+    template <class Visitor>
+    void                Accept(Visitor& visitor) const { visitor.Visit(static_cast<const Visited&>(*this)); }
+
+protected:
+    ~CVisitable() {}    //not deleted through this class
+};
+
+//visits with each of its visitors in the order given; the visitors remain owned by the caller
+template <class... Visitors>
+class CVisitors {
+
+public:
+    CVisitors(Visitors&... visitors) : visitors(visitors...) {}
+    
+    template <class Visited>
+    void                Visit(Visited& visited) { visit<0>(visited); }
+
+private:
+    template <size_t I, class Visited>
+    typename std::enable_if<(I < sizeof...(Visitors))>::type visit(Visited& visited)
+    {
+        std::get<I>(visitors).Visit(visited);
+        visit<I + 1>(visited);
+    }
+    
+    template <size_t I, class Visited>
+    typename std::enable_if<(I == sizeof...(Visitors))>::type visit(Visited&) {}
+    
+    std::tuple<Visitors&...>    visitors;
+};
+
+#endif /* defined(__Scribe2NeoScribe__CVisitor__) */
@@ -11,11 +11,16 @@
 
 #include <sstream>
 #include <iomanip> 
+#include <cstdint>
 
 
 const std::string   TRECENTO_CODES_CSV = "data/neumcode_trecento.csv";
 const std::string   CHANT_CODES_CSV = "data/neumcode_chant.csv";
 const std::string   SOURCE_KEY_CSV = "data/sourcekey.tab";
+const std::string   MANIFEST_FILE = "neoscribe.manifest";
+const std::string   JOURNAL_FILE = "neoscribe.journal";
+const std::string   CATALOGUE_FILE = "catalogue.tab";
+const std::string   CONVERTER_VERSION = "0.3";
 extern  std::string  PROCWORKINGDIRECTORY;
 
 
@@ -50,6 +55,16 @@ std::string to_string_with_precision(const T a_value, const int n = 6)
 
 
 std::string ZeroPadNumber(int num, int width);
+std::string BaseName(const std::string& path);
+std::string UncompressedName(const std::string& file_name);
+
+//fast non-cryptographic hash (64 bit FNV-1a) used to detect changes in byte ranges of Scribe files; pass a previous result as seed to chain
+const uint64_t HASH_SEED = 14695981039346656037ULL;
+uint64_t HashBytes(const char* data, size_t length, uint64_t seed = HASH_SEED);
+uint64_t HashFile(const std::string& file_name, uint64_t seed = HASH_SEED);
+
+//largest resident set of the process so far, in bytes
+size_t PeakResidentBytes();
 
 //GETLINE is a marco which calls either a safeGetline function suitable for Mac, Window, and Unix line ends; std::end is platform specific, ie. lf on unix and new mac, cr+lf on windows. Undefine _SAFEGETLINE_ if only unix files are to be processed
 #define _SAFEGETLINE_
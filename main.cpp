@@ -32,23 +32,79 @@
 
 #include <iostream>
 #include <exception>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <chrono>
+#include <sys/stat.h>
 
 #include "Header.h"
 #include "CScribeCodes.h"
 #include "CScribeReaderVisitable.h"
 #include "CScribeToNeoScribeXML.h"
+#include "CScribeWatcher.h"
+#include "CShardMerge.h"
+#include "CPrefetcher.h"
+#include "CStatistics.h"
+#include "CMensuralTimeline.h"
+#include "CMelodicIndex.h"
 
 std::string     encoder_parameter("-e");
+std::string     force_parameter("-force");
+std::string     watch_parameter("-w");
+std::string     jobs_parameter("-j");
+std::string     shard_parameter("-shard");
+std::string     merge_parameter("-merge");
+std::string     ids_parameter("-ids");
+std::string     archive_parameter("-archive");
+std::string     fanout_parameter("-fanout");
+std::string     compress_parameter("-compress");
+std::string     io_parameter("-io");
+std::string     timing_parameter("-timing");
+std::string     stream_parameter("-stream");
+std::string     compact_parameter("-compact");
+std::string     stats_parameter("-stats");
+std::string     timeline_parameter("-timeline");
+std::string     index_parameter("-index");
+std::string     merge_index_parameter("-mergeindex");
+std::string     find_parameter("-find");
+std::string     match_parameter("-match");
 std::string     appName = "Scribe2NeoScribe";
 std::string     PROCWORKINGDIRECTORY = "/usr/local/bin/";
 
+//converts a Scribe file in a single traversal shared with other consumers
+template <class Traversal>
+int ConvertWith(CScribeReaderVisitable& scribe_data, Traversal& pass)
+{
+    scribe_data.Accept(pass);
+    return scribe_data.PieceCount();
+}
+
+//prints where each hit of a melodic fragment begins
+void PrintHits(const CMelodicIndex& index, const std::vector<melodic_posting>& hits)
+{
+    for (std::vector<melodic_posting>::const_iterator hit = hits.begin(); hit != hits.end(); hit++)
+    {
+        const melodic_part& part = index.Part(hit->part);
+        const melodic_note& note = index.Note(*hit);
+        std::cout << index.FileName(part.file) << '\t' << part.part << '\t' << note.row << '\t' << note.event << '\n';
+    }
+}
+
 int main(int argc, const char * argv[])
 {
     
     if (argc < 2)
     {
         std::cout << "Insufficient or incorrect parameters." << std::endl;
-        std::cout << "Usage: Scribe2NeoScribe [-e encoder] file ..." << std::endl;
+        std::cout << "Usage: Scribe2NeoScribe [-e encoder] [-force] [-ids] [-compact] [-archive file.tar | -fanout] [-compress gzip|zstd[:level]] [-io blocking|threads|uring] [-stream] [-timing] [-stats] [-timeline file.tab] file ..." << std::endl;
+        std::cout << "       Scribe2NeoScribe [-e encoder] [-j workers] -w directory" << std::endl;
+        std::cout << "       Scribe2NeoScribe [-e encoder] [-force] [-ids] [-compact] -shard k/n file ..." << std::endl;
+        std::cout << "       Scribe2NeoScribe -merge shard_directory ..." << std::endl;
+        std::cout << "       Scribe2NeoScribe [-j workers] -index index_file file ..." << std::endl;
+        std::cout << "       Scribe2NeoScribe -mergeindex index_file index_file ..." << std::endl;
+        std::cout << "       Scribe2NeoScribe -find index_file fragment" << std::endl;
+        std::cout << "       Scribe2NeoScribe -match index_file fragment" << std::endl;
         exit(1); //add help here
     }
     
@@ -74,51 +130,379 @@ int main(int argc, const char * argv[])
         }
         
         std::stringstream encoder;
+        bool force = false;
+        std::string watch_directory;
+        int jobs = 2;
+        int shard = 0, shard_count = 0;
+        bool merge = false;
+        bool deterministic_ids = false;
+        std::string archive_file;
+        bool fanout = false;
+        std::string compression;
+        int compression_level = 6;
+        io_backend_t io = blocking_io;
+        bool timing = false;
+        bool stream = false;
+        bool compact = false;
+        bool stats = false;
+        std::string timeline_file;
+        std::string index_file;
+        bool merge_index = false;
         int i = 1;
         
-        //see if encoder name is indicated
-        if (argv[i]==encoder_parameter)
+        encoder << "Unknown";
+        
+        //read options preceding file names
+        while (i<argc && argv[i][0]=='-')
         {
-            encoder << argv[2];
-            i = 3; //first file
+            if (argv[i]==encoder_parameter && i+1<argc)
+            {
+                encoder.str(argv[i+1]);
+                i += 2;
+            }
+            else if (argv[i]==force_parameter)
+            {
+                force = true; //convert even if output is current
+                i++;
+            }
+            else if (argv[i]==ids_parameter)
+            {
+                deterministic_ids = true; //same input, same ids
+                i++;
+            }
+            else if (argv[i]==archive_parameter && i+1<argc)
+            {
+                archive_file = argv[i+1]; //append all pieces to one tar archive
+                i += 2;
+            }
+            else if (argv[i]==compress_parameter && i+1<argc)
+            {
+                //method, optionally followed by a level, eg. gzip:9 or zstd:19
+                compression = argv[i+1];
+                std::string::size_type colon = compression.find(':');
+                std::string level;
+                if (colon != std::string::npos)
+                {
+                    level = compression.substr(colon + 1);
+                    compression.erase(colon);
+                }
+                if (compression != "gzip" && compression != "zstd")
+                {
+                    std::cerr << "Scribe2NeoScribe: Unknown compression " << compression << std::endl;
+                    return 0;
+                }
+                char rest;
+                if (!level.empty() && (std::sscanf(level.c_str(), "%d%c", &compression_level, &rest) != 1 || compression_level < 1
+                    || compression_level > CCompressingWriter::max_level(compression == "zstd" ? zstd_compression : gzip_compression)))
+                {
+                    std::cerr << "Scribe2NeoScribe: Bad compression level " << level << std::endl;
+                    return 0;
+                }
+                i += 2;
+            }
+            else if (argv[i]==io_parameter && i+1<argc)
+            {
+                //how the files of a batch are read and written
+                std::string backend(argv[i+1]);
+                if (backend == "blocking") io = blocking_io;
+                else if (backend == "threads") io = threaded_io;
+                else if (backend == "uring") io = uring_io;
+                else
+                {
+                    std::cerr << "Scribe2NeoScribe: Unknown I/O backend " << backend << std::endl;
+                    return 0;
+                }
+                i += 2;
+            }
+            else if (argv[i]==timing_parameter)
+            {
+                timing = true; //report where the time of a batch went
+                i++;
+            }
+            else if (argv[i]==compact_parameter)
+            {
+                compact = true; //smaller MEI for machine consumers
+                i++;
+            }
+            else if (argv[i]==timeline_parameter && i+1<argc)
+            {
+                timeline_file = argv[i+1]; //onsets and durations of the events of trecento pieces
+                i += 2;
+            }
+            else if (argv[i]==stats_parameter)
+            {
+                stats = true; //count the parts, rows and events of the files converted
+                i++;
+            }
+            else if (argv[i]==stream_parameter)
+            {
+                stream = true; //write each section of a piece as soon as it is converted, then release it
+                i++;
+            }
+            else if (argv[i]==fanout_parameter)
+            {
+                fanout = true; //spread files over hashed directories
+                i++;
+            }
+            else if (argv[i]==watch_parameter && i+1<argc)
+            {
+                watch_directory = argv[i+1];
+                i += 2;
+            }
+            else if (argv[i]==jobs_parameter && i+1<argc)
+            {
+                jobs = std::atoi(argv[i+1]);
+                i += 2;
+            }
+            else if (argv[i]==shard_parameter && i+1<argc)
+            {
+                //shards are numbered from 1 to n
+                if (std::sscanf(argv[i+1], "%d/%d", &shard, &shard_count) != 2 || shard < 1 || shard > shard_count)
+                {
+                    std::cerr << "Scribe2NeoScribe: Bad shard " << argv[i+1] << std::endl;
+                    return 0;
+                }
+                i += 2;
+            }
+            else if (argv[i]==index_parameter && i+1<argc)
+            {
+                index_file = argv[i+1]; //index the melodies of the files instead of converting them
+                i += 2;
+            }
+            else if (argv[i]==merge_index_parameter && i+1<argc)
+            {
+                index_file = argv[i+1];
+                merge_index = true; //remaining parameters are melodic indexes
+                i += 2;
+                break;
+            }
+            else if (argv[i]==find_parameter && i+2<argc)
+            {
+                //search a melodic index for a fragment
+                typedef std::chrono::steady_clock query_clock;
+                query_clock::time_point query_start = query_clock::now();
+                
+                CMelodicIndex index(argv[i+1]);
+                std::vector<int> intervals;
+                std::vector<melodic_posting> hits;
+                
+                CMelodicIndex::ParseFragment(argv[i+2], intervals);
+                index.Find(intervals, hits);
+                
+                double elapsed = std::chrono::duration<double, std::milli>(query_clock::now() - query_start).count();
+                
+                PrintHits(index, hits);
+                std::cout << hits.size() << " hit(s) among " << index.NoteCount() << " note(s) of " << index.FileCount() << " file(s), found in " << elapsed << " ms." << std::endl;
+                return 0;
+            }
+            else if (argv[i]==match_parameter && i+2<argc)
+            {
+                //search a melodic index for as much of a fragment as is found, by its suffix array
+                typedef std::chrono::steady_clock query_clock;
+                query_clock::time_point query_start = query_clock::now();
+                
+                CMelodicIndex index(argv[i+1]);
+                std::vector<int> intervals;
+                std::vector<melodic_posting> hits;
+                
+                CMelodicIndex::ParseFragment(argv[i+2], intervals);
+                size_t matched = index.Match(intervals, hits);
+                
+                double elapsed = std::chrono::duration<double, std::milli>(query_clock::now() - query_start).count();
+                
+                PrintHits(index, hits);
+                std::cout << hits.size() << " hit(s) of the first " << matched << " of " << intervals.size() << " interval(s) among " << index.NoteCount() << " note(s) of " << index.FileCount() << " file(s), found in " << elapsed << " ms." << std::endl;
+                return 0;
+            }
+            else if (argv[i]==merge_parameter)
+            {
+                merge = true; //remaining parameters are shard directories
+                i++;
+                break;
+            }
+            else
+            {
+                std::cerr << "Scribe2NeoScribe: Unknown parameter " << argv[i] << std::endl;
+                return 0;
+            }
+        }
+        
+        //watch mode - reconvert Scribe files in a directory whenever they change; runs until killed
+        if (!watch_directory.empty())
+        {
+            CScribeWatcher watcher(watch_directory, encoder.str(), jobs);
+            watcher.Run();
+            return 0;
         }
-        else
-            encoder << "Unknown";
         
         if (i>argc-1) { std::cerr << "Scribe2NeoScribe: Bad parameter count" << std::endl; return 0; }
         
-        std::string file(argv[i]); //file name currently supplied as call parameter
+        //melodic index mode - index the files in parallel, or merge indexes made separately, into one index file
+        if (!index_file.empty())
+        {
+            melodic_segment index;
+            
+            if (merge_index)
+            {
+                std::vector<melodic_segment> segments(argc - i);
+                for (int s = 0; i < argc; i++, s++) CMelodicIndex(argv[i]).Load(segments[s]);
+                index.merge(segments);
+            }
+            else
+                CMelodicIndexer::Build(std::vector<std::string>(argv + i, argv + argc), jobs, index);
+            
+            index.sort_suffixes(jobs);
+            index.save(index_file);
+            std::cout << index.notes.size() << " note(s) of " << index.parts.size() << " part(s) of " << index.files.size() << " file(s) indexed in " << index_file << "." << std::endl;
+            return 0;
+        }
         
-        if (file.empty())  { std::cerr << "Scribe2NeoScribe: Bad file parameter" << std::endl; return 0; }
-    
-        std::cout << "Converting " << argv[i] << "..." << std::endl;
+        //merge mode - combine the results of shards converted separately into the current directory
+        if (merge)
+        {
+            CShardMerge merger(std::vector<std::string>(argv + i, argv + argc));
+            std::cout << merger.Run() << " MEI file(s) merged." << std::endl;
+            return 0;
+        }
         
-        CScribeReaderVisitable scribe_data(file);
+        if (shard_count && (fanout || !archive_file.empty())) { std::cerr << "Scribe2NeoScribe: Shards are written as loose files" << std::endl; return 0; }
         
-        CScribeToNeoScribeXML nsXML(encoder.str());
+        //a shard keeps its MEI files, manifest, journal and catalogue in its own directory
+        std::string shard_directory;
+        
+        if (shard_count)
+        {
+            shard_directory = "shard-" + std::to_string(shard);
+            mkdir(shard_directory.c_str(), 0755);
+        }
+        
+        std::string prefix = shard_directory.empty() ? "" : shard_directory + "/";
+        
+        //an interrupted batch leaves its journal behind; pieces it committed are not converted again
+        CManifest manifest(prefix + MANIFEST_FILE);
+        CJournal journal(prefix + JOURNAL_FILE);
+        CCatalogue catalogue(prefix + CATALOGUE_FILE);
+        
+        std::unique_ptr<CMEIWriter> writer;
+        
+        //loose files are written under temporary names and renamed into place in batches
+        if (!archive_file.empty()) writer.reset(new CTarWriter(archive_file));
+        else if (fanout) writer.reset(new CFanOutWriter);
+#ifdef HAVE_LIBURING
+        else if (io == uring_io) writer.reset(new CUringWriter);
+#endif
+        else writer.reset(new CAtomicWriter);
+        
+        //compressed files are passed on to the archive, fan-out or loose files
+        if (!compression.empty())
+            writer.reset(new CCompressingWriter(writer.release(), compression == "zstd" ? zstd_compression : gzip_compression, compression_level));
+        
+        //the writer is asked whether each committed output is still there, including members of an archive
+        int resumed = journal.replay(manifest, writer.get());
+        if (resumed) std::cout << "Resuming interrupted conversion (" << resumed << " committed outputs)." << std::endl;
+        
+        CScribeToNeoScribeXML nsXML(encoder.str(), &manifest);
+        nsXML.SetForceConversion(force);
+        nsXML.SetDeterministicIds(deterministic_ids);
+        nsXML.SetStreaming(stream);
+        nsXML.SetCompact(compact);
+        
+        nsXML.SetWriter(writer.get());
+        nsXML.SetJournal(&journal);
+        
+        if (shard_count)
+        {
+            nsXML.SetShard(shard - 1, shard_count, shard_directory);
+            nsXML.SetCatalogue(&catalogue);
+        }
+        
+        int piece_count = 0;
+        std::vector<std::string> files;
+        CStatistics statistics;
+        std::unique_ptr<CMensuralTimeline> timeline;
+        
+        if (!timeline_file.empty()) timeline.reset(new CMensuralTimeline(timeline_file));
+        
+        //statistics and timelines, if asked for, are made in the same pass over each file as its conversion
+        COptionalConsumer<CStatistics> optional_statistics(stats ? &statistics : NULL);
+        COptionalConsumer<CMensuralTimeline> optional_timeline(timeline.get());
+        CScribeTraversal<CScribeToNeoScribeXML, COptionalConsumer<CStatistics>, COptionalConsumer<CMensuralTimeline> > pass(nsXML, optional_statistics, optional_timeline);
         
         for ( ; i<argc; i++)
         {
+            std::string file(argv[i]); //file name currently supplied as call parameter
+            
+            if (file.empty())  { std::cerr << "Scribe2NeoScribe: Bad file parameter" << std::endl; continue; }
+            
+            files.push_back(file);
+        }
+        
+        //files are read ahead of their conversion unless the blocking backend is used
+        typedef std::chrono::steady_clock batch_clock;
+        batch_clock::time_point start = batch_clock::now();
+        batch_clock::duration reading = batch_clock::duration::zero(), converting = batch_clock::duration::zero();
+        long long bytes_read = 0;
+        
+        CPrefetcher prefetcher(files, io);
+        prefetched_file file;
+        
+        while (true)
+        {
+            batch_clock::time_point read_start = batch_clock::now();
+            if (!prefetcher.next(file)) break;
+            batch_clock::time_point convert_start = batch_clock::now();
+            reading += convert_start - read_start;
+            bytes_read += file.contents.size();
             
-            if (scribe_data.PieceCount()==1)
+            //skip without parsing if nothing has changed since the last conversion, unless every file is to be timed
+            if (!timeline && (file.found ? nsXML.IsCurrent(file.name, HashBytes(file.contents.data(), file.contents.size())) : nsXML.IsCurrent(file.name)))
             {
-                scribe_data.Accept(nsXML);
-                
-                //test functions
-                //scribe_data.print();
-                
-                //nsXML.PrintMEIXML();
-                
-                std::string xml_file = file + ".xml";
-                
-                nsXML.SaveMEIXML(xml_file);
+                std::cout << file.name << " is up to date." << std::endl;
+                converting += batch_clock::now() - convert_start;
+                continue;
             }
-            else if (scribe_data.PieceCount()>1) 
-                nsXML.SegmentScribe2MEIXML(scribe_data);
             
+            std::cout << "Converting " << file.name << "..." << std::endl;
+            
+            std::unique_ptr<CScribeReaderVisitable> scribe_data(file.found ? new CScribeReaderVisitable(file.name, file.contents) : new CScribeReaderVisitable(file.name));
+            
+            //test functions
+            //scribe_data->print();
+            
+            //nsXML.PrintMEIXML();
+            
+            piece_count += ConvertWith(*scribe_data, pass);
+            converting += batch_clock::now() - convert_start;
         }
         
-        std::cout << scribe_data.PieceCount() << " piece(s) converted to NeoScribeXML." << std::endl;
+        //the batch is complete, so its journal is no longer needed once the outputs are closed and the manifest is saved
+        batch_clock::time_point close_start = batch_clock::now();
+        writer->close();
+        batch_clock::duration closing = batch_clock::now() - close_start;
+        manifest.save();
+        journal.remove();
+        
+        if (timing)
+        {
+            typedef std::chrono::duration<double, std::milli> ms;
+            const char* backends[] = { "blocking", "threads", "uring" };
+            
+            std::cout << "I/O " << backends[prefetcher.backend()] << ": " << files.size() << " file(s), " << bytes_read << " bytes read; "
+            << "waiting for input " << ms(reading).count() << " ms, converting " << ms(converting).count() << " ms, "
+            << "finishing output " << ms(closing).count() << " ms, total " << ms(batch_clock::now() - start).count() << " ms; "
+            << "peak memory " << PeakResidentBytes() / 1024 << " KB." << std::endl;
+        }
+        
+        if (stats) statistics.Print(std::cout);
+        if (timeline) std::cout << timeline->EntryCount() << " event(s) of " << timeline->PieceCount() << " trecento piece(s) timed in " << timeline_file << "." << std::endl;
+        
+        if (shard_count)
+        {
+            catalogue.save();
+            std::cout << catalogue.size() << " piece(s) of shard " << shard << "/" << shard_count << " converted to NeoScribeXML." << std::endl;
+        }
+        else
+            std::cout << piece_count << " piece(s) converted to NeoScribeXML." << std::endl;
         
     } catch (std::exception& e) {
         std::cerr << "Standard exception: " << e.what() << std::endl;
@@ -0,0 +1,60 @@
+//
+//  CAttributeValues.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  Tables are built on first use; C++11 guarantees this is safe when converters run in several threads.
+//
+
+#include "CAttributeValues.h"
+
+#include <vector>
+
+
+const std::string CAttributeValues::red = "red";
+const std::string CAttributeValues::blue = "blue";
+const std::string CAttributeValues::true_value = "true";
+
+const std::string& CAttributeValues::letter(const char c)
+{
+    static const std::vector<std::string> letters = [] {
+        std::vector<std::string> table;
+        for (int i = 0; i < 256; i++) table.push_back(std::string(1, static_cast<char>(i)));
+        return table;
+    }();
+    
+    return letters[static_cast<unsigned char>(c)];
+}
+
+const std::string& CAttributeValues::number(const int n)
+{
+    static const std::vector<std::string> numbers = [] {
+        std::vector<std::string> table;
+        for (int i = min_number; i <= max_number; i++) table.push_back(std::to_string(i));
+        return table;
+    }();
+    
+    if (n >= min_number && n <= max_number) return numbers[n - min_number];
+    
+    static thread_local std::string untabulated;
+    untabulated = std::to_string(n);
+    return untabulated;
+}
+
+//the offset is in half spaces between staff lines, rendered as by earlier versions of the converter
+const std::string& CAttributeValues::vertical_offset(const int tenths)
+{
+    static const std::vector<std::string> offsets = [] {
+        std::vector<std::string> table;
+        for (int i = -max_offset; i <= max_offset; i++) table.push_back(to_string_with_precision(static_cast<float>(i/10.0*2), 1));
+        return table;
+    }();
+    
+    if (tenths >= -max_offset && tenths <= max_offset) return offsets[tenths + max_offset];
+    
+    static thread_local std::string untabulated;
+    untabulated = to_string_with_precision(static_cast<float>(tenths/10.0*2), 1);
+    return untabulated;
+}
@@ -0,0 +1,80 @@
+//
+//  CCatalogue.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CCatalogue.h"
+#include "CScribeReaderVisitable.h"
+
+#include <fstream>
+
+
+CCatalogue::CCatalogue(const std::string& catalogue_file)
+: catalogue_file(catalogue_file)
+{
+    load_catalogue();
+}
+
+//  =========================================================================================
+//  load_catalogue
+//  This function loads a previously saved catalogue, so that rows of pieces not converted
+//  again are kept; a missing catalogue is an empty one
+//  =========================================================================================
+
+void    CCatalogue::load_catalogue()
+{
+    std::ifstream   file ( catalogue_file.c_str() );
+    std::string     line;
+    
+    if (!file.is_open()) return;
+    
+    while (file)
+    {
+        GETLINE(file, line);
+        
+        std::string::size_type tab = line.find('\t');
+        
+        if (tab != std::string::npos) rows[line.substr(0, tab)] = line.substr(tab + 1);
+        line.clear();
+    }
+}
+
+void    CCatalogue::add(const std::string& xml_file, const std::string& scribe_file, const scribe_part& part)
+{
+    std::string number = part.rep_num.empty() ? std::to_string(part.cao_num) : part.rep_num;
+    
+    add(xml_file, scribe_file + '\t' + part.abbrev_ms + '\t' + part.folios + '\t' + number + '\t' + part.title);
+}
+
+void    CCatalogue::add(const std::string& xml_file, const std::string& row)
+{
+    rows[xml_file] = row;
+}
+
+//rows of other replace rows of the same MEI file
+void    CCatalogue::merge(const CCatalogue& other)
+{
+    for (std::map<std::string, std::string>::const_iterator i = other.rows.begin(); i != other.rows.end(); i++)
+    {
+        rows[i->first] = i->second;
+    }
+}
+
+void    CCatalogue::save() const
+{
+    std::ofstream file ( catalogue_file.c_str() );
+    
+    if (!file.is_open())
+    {
+        std::cerr << "Could not save catalogue " << catalogue_file << std::endl;
+        return;
+    }
+    
+    for (std::map<std::string, std::string>::const_iterator i = rows.begin(); i != rows.end(); i++)
+    {
+        file << i->first << '\t' << i->second << '\n';
+    }
+}
@@ -0,0 +1,152 @@
+//
+//  CJournal.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  Each line of the journal is tab delimited:
+//      key - name of an MEI file written, or of a Scribe file all of whose pieces have been written
+//      fingerprint - hexadecimal fingerprint of the input, as recorded in the manifest
+//      owner - for MEI files, the Scribe file from which it was written
+//      size - for MEI files, the number of bytes written, used to detect partial outputs
+//
+//  Records are appended as pieces are stored and synced to disk every sync_interval records, so an
+//  interruption loses at most the last few records; those pieces are simply converted again.
+//
+
+#include "CJournal.h"
+#include "CManifest.h"
+#include "CMEIWriter.h"
+
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+CJournal::CJournal(const std::string& journal_file, const int sync_interval)
+: journal_file(journal_file), sync_interval(sync_interval)
+{
+}
+
+CJournal::~CJournal()
+{
+    if (fd >= 0)
+    {
+        sync();
+        close(fd);
+    }
+}
+
+//  =========================================================================================
+//  replay
+//  input: manifest to bring up to date, writer the MEI files will be written with
+//  output: number of records accepted
+//  Records of MEI files are only accepted if the writer still has the file and, where a size was
+//  recorded, it is unchanged; records of Scribe files are accepted as they are, since the manifest
+//  also checks their outputs exist
+//  =========================================================================================
+
+int     CJournal::replay(CManifest& manifest, const CMEIWriter* writer)
+{
+    std::ifstream   file ( journal_file.c_str() );
+    std::string     line;
+    int             accepted = 0;
+    
+    if (!file.is_open()) return 0;
+    
+    while (file)
+    {
+        GETLINE(file, line);
+        std::stringstream lineStream(line);
+        std::string key, fingerprint, owner, size;
+        
+        //a final record cut short by an interruption has no size field and is ignored
+        if ( std::getline(lineStream, key, '\t') && std::getline(lineStream, fingerprint, '\t') && std::getline(lineStream, owner, '\t') && std::getline(lineStream, size, '\t') )
+        {
+            long long expected_size = std::atoll(size.c_str());
+            
+            //members of an archive have no size of their own; the archive's table of contents holds only complete members
+            if (!owner.empty())
+            {
+                struct stat info;
+                bool present = writer ? writer->exists(key) : stat(key.c_str(), &info) == 0;
+                if (!present) continue; //missing output
+                if (expected_size >= 0 && (stat(key.c_str(), &info) != 0 || info.st_size != expected_size)) continue; //partial output
+            }
+            
+            manifest.update(key, std::strtoull(fingerprint.c_str(), NULL, 16), owner);
+            committed_keys.insert(key);
+            accepted++;
+        }
+        line.clear();
+    }
+    
+    return accepted;
+}
+
+//  =========================================================================================
+//  record
+//  input: name of MEI file stored, or of Scribe file committed, fingerprint of its input, owning Scribe file
+//  output: nil
+//  =========================================================================================
+
+void    CJournal::record(const std::string& key, const uint64_t fingerprint, const std::string& owner)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (fd < 0)
+    {
+        fd = open(journal_file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw std::runtime_error("Could not open journal " + journal_file);
+    }
+    
+    long long size = -1;
+    
+    if (!owner.empty())
+    {
+        struct stat info;
+        if (stat(key.c_str(), &info) == 0) size = info.st_size;
+    }
+    
+    std::ostringstream record;
+    record << key << '\t' << std::hex << fingerprint << std::dec << '\t' << owner << '\t' << size << '\n';
+    
+    std::string text = record.str();
+    if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size()))
+        throw std::runtime_error("Could not write journal " + journal_file);
+    
+    if (++unsynced >= sync_interval)
+    {
+        fsync(fd);
+        unsynced = 0;
+    }
+}
+
+void    CJournal::sync()
+{
+    if (fd >= 0 && unsynced > 0)
+    {
+        fsync(fd);
+        unsynced = 0;
+    }
+}
+
+//the batch is complete and its results are in the manifest
+void    CJournal::remove()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    unsynced = 0;
+    std::remove(journal_file.c_str());
+}
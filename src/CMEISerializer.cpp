@@ -0,0 +1,363 @@
+//
+//  CMEISerializer.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CMEISerializer.h"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+static const char* mei_namespace = "http://www.music-encoding.org/ns/mei";
+static const char* mei_version = "2013";
+
+CMEISerializer::CMEISerializer(std::string& output, const bool pretty, const int indentation)
+: output(output), pretty(pretty), indentation(pretty ? indentation : 0)
+{
+}
+
+void    CMEISerializer::declaration()
+{
+    output += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    end_line();
+}
+
+//entity or character reference written in place of c, as libxml2 writes them, or NULL if there is none
+static inline const char* entity(const char c, const bool attribute)
+{
+    switch (c)
+    {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '>': return "&gt;";
+        case '"': return attribute ? "&quot;" : NULL;
+        case '\r': return "&#13;";
+        case '\n': return attribute ? "&#10;" : NULL;
+        case '\t': return attribute ? "&#9;" : NULL;
+        default: return NULL;
+    }
+}
+
+//length of the UTF-8 sequence starting text, or 0 if it is not a well formed one
+static inline size_t utf8_length(const unsigned char* text, const size_t size)
+{
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF;  //bounds of the second byte, excluding overlong forms and surrogates
+    
+    if (text[0] < 0x80) return 1;
+    else if (text[0] >= 0xC2 && text[0] <= 0xDF) length = 2;
+    else if (text[0] >= 0xE0 && text[0] <= 0xEF)
+    {
+        length = 3;
+        if (text[0] == 0xE0) low = 0xA0;
+        if (text[0] == 0xED) high = 0x9F;
+    }
+    else if (text[0] >= 0xF0 && text[0] <= 0xF4)
+    {
+        length = 4;
+        if (text[0] == 0xF0) low = 0x90;
+        if (text[0] == 0xF4) high = 0x8F;
+    }
+    else return 0;
+    
+    if (size < length || text[1] < low || text[1] > high) return 0;
+    for (size_t i = 2; i < length; i++)
+        if ((text[i] & 0xC0) != 0x80) return 0;
+    
+    return length;
+}
+
+//appends the text from start up to the character at at, followed by what is written in its place, if anything;
+//returns the index of the byte following the character
+static inline size_t escape_character(const char* data, const size_t size, const size_t at, const bool attribute, std::string& output, size_t& start)
+{
+    const unsigned char c = static_cast<unsigned char>(data[at]);
+    const char* replacement = entity(data[at], attribute);
+    char reference[8];
+    
+    if (!replacement)
+    {
+        size_t length = c >= 0x20 || c == '\n' || c == '\t' ? utf8_length(reinterpret_cast<const unsigned char*>(data + at), size - at) : 0;
+        if (length) return at + length;
+        
+        //other control characters, and bytes that are not UTF-8, are written as references to the character of their value
+        std::snprintf(reference, sizeof(reference), "&#x%X;", c);
+        replacement = reference;
+    }
+    
+    output.append(data + start, at - start);
+    output += replacement;
+    start = at + 1;
+    return at + 1;
+}
+
+//  =========================================================================================
+//  escape
+//  input: text of an element or attribute value, text to append it to, whether it is an attribute value
+//  output: nil
+//  Text is written as libxml2 writes it for XmlExport: &, <, > and (in attribute values) " as entities,
+//  carriage returns and (in attribute values) line feeds and tabs as character references. Other control
+//  characters, and bytes that are not part of well formed UTF-8, are written as character references too.
+//  Text is scanned 32 (AVX2) or 16 (SSE2) bytes at a time for these and for the bytes of non-ASCII
+//  characters, which are checked; runs of text between them are appended whole. The rest of the text,
+//  and all of it in other builds, is scanned a byte at a time.
+//  =========================================================================================
+
+void    CMEISerializer::escape(const std::string& text, std::string& output, const bool attribute)
+{
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t start = 0, i = 0;    //start of the run not yet appended, next block to scan
+    size_t next = 0;            //next byte not within a character already scanned
+    
+    output.reserve(output.size() + size);
+    
+#if defined(__AVX2__)
+    //outside attributes, '"' is looked for as a second '&'; as signed bytes, control characters and
+    //the bytes of non-ASCII characters are all less than a space
+    const __m256i amp = _mm256_set1_epi8('&'), lt = _mm256_set1_epi8('<'), gt = _mm256_set1_epi8('>'), quot = _mm256_set1_epi8(attribute ? '"' : '&');
+    const __m256i space = _mm256_set1_epi8(' ');
+    
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, amp), _mm256_cmpeq_epi8(block, lt)),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(block, gt), _mm256_cmpeq_epi8(block, quot)));
+        special = _mm256_or_si256(special, _mm256_cmpgt_epi8(space, block));
+        
+        for (unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special)); mask; mask &= mask - 1)
+        {
+            size_t at = i + __builtin_ctz(mask);
+            if (at >= next) next = escape_character(data, size, at, attribute, output, start);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i amp = _mm_set1_epi8('&'), lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>'), quot = _mm_set1_epi8(attribute ? '"' : '&');
+    const __m128i space = _mm_set1_epi8(' ');
+    
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, amp), _mm_cmpeq_epi8(block, lt)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(block, gt), _mm_cmpeq_epi8(block, quot)));
+        special = _mm_or_si128(special, _mm_cmplt_epi8(block, space));
+        
+        for (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special)); mask; mask &= mask - 1)
+        {
+            size_t at = i + __builtin_ctz(mask);
+            if (at >= next) next = escape_character(data, size, at, attribute, output, start);
+        }
+    }
+#endif
+    
+    for (i = std::max(i, next); i < size; )
+        i = escape_character(data, size, i, attribute, output, start);
+    
+    output.append(data + start, size - start);
+}
+
+void    CMEISerializer::indent()
+{
+    if (pretty) output.append(depth * indentation, ' ');
+}
+
+void    CMEISerializer::end_line()
+{
+    if (pretty) output += '\n';
+}
+
+//writes the start tag of element without closing it
+void    CMEISerializer::start_tag(MeiElement* element)
+{
+    indent();
+    output += '<';
+    output += element->getName();
+    
+    if (depth == 0)
+    {
+        output += " xmlns=\"";
+        output += mei_namespace;
+        output += "\" meiversion=\"";
+        output += mei_version;
+        output += '"';
+    }
+    
+    output += " xml:id=\"";
+    
+    //a fragment being rendered is split at each id
+    if (rendering)
+    {
+        rendering->text.push_back(output.substr(rendered_to));
+        rendering->ids.push_back(element->getId());
+    }
+    
+    escape(element->getId(), output, true);
+    rendered_to = output.size();
+    output += '"';
+    
+    std::vector<MeiAttribute*>& attributes = element->getAttributes();
+    for (std::vector<MeiAttribute*>::iterator a = attributes.begin(); a != attributes.end(); a++)
+    {
+        output += ' ';
+        output += (*a)->getName();
+        output += "=\"";
+        escape((*a)->getValue(), output, true);
+        output += '"';
+    }
+}
+
+//writes the start tag and text of element; its children are to follow, then close
+void    CMEISerializer::open(MeiElement* element)
+{
+    start_tag(element);
+    output += '>';
+    escape(element->getValue(), output, false);
+    end_line();
+    depth++;
+}
+
+void    CMEISerializer::close(MeiElement* element)
+{
+    depth--;
+    indent();
+    output += "</";
+    output += element->getName();
+    output += '>';
+    end_line();
+}
+
+//writes element and everything it contains, or the fragment standing in for it
+void    CMEISerializer::write(MeiElement* element)
+{
+    for (std::vector<stand_in_element>::const_iterator s = stand_ins.begin(); s != stand_ins.end(); s++)
+    {
+        if (s->element == element)
+        {
+            splice(*s->rendered, s->ids);
+            return;
+        }
+    }
+    
+    if (dynamic_cast<MeiCommentNode*>(element))
+    {
+        indent();
+        output += "<!--";
+        output += element->getValue();
+        output += "-->";
+        end_line();
+        return;
+    }
+    
+    const std::vector<MeiElement*>& children = element->getChildren();
+    
+    if (children.empty())
+    {
+        start_tag(element);
+        
+        std::string value = element->getValue();
+        if (value.empty())
+        {
+            output += "/>";
+            end_line();
+        }
+        else
+        {
+            output += '>';
+            escape(value, output, false);
+            output += "</";
+            output += element->getName();
+            output += '>';
+            end_line();
+        }
+        return;
+    }
+    
+    //as in libxml2, an element holding text as well as elements is written without line breaks or indentation
+    //within it, which would change its text
+    bool mixed = !element->getValue().empty();
+    for (std::vector<MeiElement*>::const_iterator child = children.begin(); child != children.end() && !mixed; child++)
+        mixed = !(*child)->getTail().empty();
+    
+    bool was_pretty = pretty;
+    
+    if (mixed && pretty)
+    {
+        indent();
+        pretty = false;
+    }
+    
+    open(element);
+    
+    //the text following a child, its tail, is written after it
+    for (std::vector<MeiElement*>::const_iterator child = children.begin(); child != children.end(); child++)
+    {
+        write(*child);
+        escape((*child)->getTail(), output, false);
+    }
+    
+    close(element);
+    
+    if (was_pretty && !pretty)
+    {
+        pretty = true;
+        end_line();
+    }
+}
+
+//===================================================================================================
+//
+//  Functions:  render, stand_in
+//  Purpose:    render writes element and everything it contains, as it would be written at depth, to a
+//              fragment. stand_in has the fragment written wherever element is written, instead of element
+//              itself, with ids in place of the ids it was rendered with, if they are given; they must be as
+//              many, and are kept by the caller until the serializer is done with.
+//
+//===================================================================================================
+
+void    CMEISerializer::render(MeiElement* element, fragment& rendered, const bool pretty, const int indentation, const int depth)
+{
+    std::string text;
+    CMEISerializer serializer(text, pretty, indentation);
+    
+    rendered = fragment();
+    rendered.depth = depth;
+    rendered.pretty = pretty;
+    
+    serializer.depth = depth;
+    serializer.rendering = &rendered;
+    serializer.write(element);
+    
+    rendered.text.push_back(text.substr(serializer.rendered_to));
+}
+
+void    CMEISerializer::stand_in(MeiElement* element, const fragment* rendered, const std::vector<std::string>* ids)
+{
+    if (ids && ids->size() != rendered->ids.size()) throw std::logic_error("Fragment given the wrong number of ids");
+    
+    stand_in_element standing = { element, rendered, ids };
+    stand_ins.push_back(standing);
+}
+
+void    CMEISerializer::splice(const fragment& rendered, const std::vector<std::string>* ids)
+{
+    //the fragment's indentation and line breaks are only right where it was rendered for
+    if (rendered.depth != depth || rendered.pretty != pretty) throw std::logic_error("Fragment written where it was not rendered for");
+    
+    const std::vector<std::string>& written_ids = ids ? *ids : rendered.ids;
+    
+    output += rendered.text[0];
+    for (size_t i = 0; i < written_ids.size(); i++)
+    {
+        escape(written_ids[i], output, true);
+        output += rendered.text[i + 1];
+    }
+}
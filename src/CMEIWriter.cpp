@@ -0,0 +1,900 @@
+//
+//  CMEIWriter.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CMEIWriter.h"
+
+#include <exception>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <set>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+//  =========================================================================================
+//  CMEIWriter
+//  Unless a writer stores the pieces of a file as they are appended, they are collected and the
+//  file is written whole
+//  =========================================================================================
+
+void    CMEIWriter::begin(const std::string& location)
+{
+    collected_location = location;
+    collected_text.clear();
+}
+
+void    CMEIWriter::append(const std::string& text)
+{
+    collected_text += text;
+}
+
+void    CMEIWriter::end()
+{
+    std::string text;
+    text.swap(collected_text);
+    
+    write(collected_location, text);
+}
+
+//  =========================================================================================
+//  CFileWriter
+//  =========================================================================================
+
+void    CFileWriter::write(const std::string& location, const std::string& text)
+{
+    std::ofstream file ( location.c_str(), std::ios::binary );
+    
+    if (!file.is_open()) throw std::runtime_error("Could not write " + location);
+    
+    file.write(text.data(), text.size());
+    file.close();
+    
+    if (!file) throw std::runtime_error("Could not write " + location);
+    notify_stored(location);
+}
+
+const bool CFileWriter::exists(const std::string& location) const
+{
+    struct stat info;
+    
+    return stat(location.c_str(), &info) == 0;
+}
+
+//a hidden file beside location (.name.partial), under which it is written until it is on disk
+std::string CFileWriter::temporary_name(const std::string& location)
+{
+    std::string::size_type slash = location.rfind('/');
+    
+    if (slash == std::string::npos) return "." + location + ".partial";
+    
+    return location.substr(0, slash + 1) + "." + location.substr(slash + 1) + ".partial";
+}
+
+//syncs each directory holding one of locations, so that files renamed into them are on disk
+void    CFileWriter::sync_directories(const std::vector<std::string>& locations)
+{
+    std::set<std::string> directories;
+    
+    for (std::vector<std::string>::const_iterator l = locations.begin(); l != locations.end(); l++)
+    {
+        std::string::size_type slash = l->rfind('/');
+        directories.insert(slash == std::string::npos ? "." : l->substr(0, slash + 1));
+    }
+    
+    for (std::set<std::string>::const_iterator d = directories.begin(); d != directories.end(); d++)
+    {
+        int fd = ::open(d->c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            ::close(fd);
+        }
+    }
+}
+
+//  =========================================================================================
+//  CAtomicWriter
+//  Each file is written in full, with a single write of the serialised document or as its pieces are
+//  appended, to a hidden temporary file beside its location (.name.partial), so that a file is never
+//  seen at its location incomplete. Files are committed batch_size at a time:
+//      the contents of every file in the batch are synced to disk (on Linux, with one syncfs for
+//      each file system written to rather than an fsync for each file)
+//      each file is renamed to its location
+//      each directory written to is synced, so that the renames are on disk
+//  and only then are the files reported stored. An interruption leaves at most one batch of
+//  temporary files, which are overwritten the next time the same files are written.
+//  =========================================================================================
+
+CAtomicWriter::CAtomicWriter(const size_t batch_size)
+: batch_size(batch_size ? batch_size : 1)
+{
+}
+
+CAtomicWriter::~CAtomicWriter()
+{
+    try {
+        close();
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        discard();
+    }
+}
+
+void    CAtomicWriter::write(const std::string& location, const std::string& text)
+{
+    begin(location);
+    append(text);
+    end();
+}
+
+void    CAtomicWriter::begin(const std::string& location)
+{
+    //a file begun and never ended, as when its conversion failed, is not kept
+    abandon();
+    
+    //files must be renamed in the order written, so a file written twice in one batch ends the batch
+    for (std::vector<staged_file>::const_iterator f = staged.begin(); f != staged.end(); f++)
+    {
+        if (f->location == location)
+        {
+            commit();
+            break;
+        }
+    }
+    
+    open_file.location = location;
+    open_file.temporary = temporary_name(location);
+    open_file.fd = ::open(open_file.temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    
+    if (open_file.fd < 0) throw std::runtime_error("Could not write " + location);
+}
+
+void    CAtomicWriter::append(const std::string& text)
+{
+    if (open_file.fd < 0) throw std::logic_error("No file begun to append to");
+    
+    size_t done = 0;
+    while (done < text.size())
+    {
+        ssize_t more = ::write(open_file.fd, text.data() + done, text.size() - done);
+        if (more < 0 && errno == EINTR) continue;
+        if (more <= 0)
+        {
+            std::string location = open_file.location;
+            abandon();
+            throw std::runtime_error("Could not write " + location);
+        }
+        done += static_cast<size_t>(more);
+    }
+}
+
+void    CAtomicWriter::end()
+{
+    if (open_file.fd < 0) throw std::logic_error("No file begun to end");
+    
+    staged.push_back(open_file);
+    open_file.fd = -1;
+    
+    if (staged.size() >= batch_size) commit();
+}
+
+void    CAtomicWriter::close()
+{
+    abandon();
+    commit();
+}
+
+void    CAtomicWriter::commit()
+{
+    if (staged.empty()) return;
+    
+    //contents first, so that no file is renamed into place before its contents are on disk
+#ifdef __linux__
+    std::set<dev_t> file_systems;
+    
+    for (std::vector<staged_file>::const_iterator f = staged.begin(); f != staged.end(); f++)
+    {
+        struct stat info;
+        
+        if (fstat(f->fd, &info) != 0 || (file_systems.insert(info.st_dev).second && syncfs(f->fd) != 0))
+        {
+            discard();
+            throw std::runtime_error("Could not sync " + f->location);
+        }
+    }
+#else
+    for (std::vector<staged_file>::const_iterator f = staged.begin(); f != staged.end(); f++)
+    {
+        if (fsync(f->fd) != 0)
+        {
+            discard();
+            throw std::runtime_error("Could not sync " + f->location);
+        }
+    }
+#endif
+    
+    std::vector<std::string> committed;
+    std::vector<staged_file>::iterator f = staged.begin();
+    
+    //a file that cannot be renamed ends the batch; those renamed before it are still reported stored
+    for (; f != staged.end(); f++)
+    {
+        ::close(f->fd);
+        f->fd = -1;
+        
+        if (std::rename(f->temporary.c_str(), f->location.c_str()) != 0) break;
+        committed.push_back(f->location);
+    }
+    
+    sync_directories(committed);
+    staged.erase(staged.begin(), f);
+    
+    std::string failed = staged.empty() ? "" : staged.front().location;
+    discard();
+    
+    for (std::vector<std::string>::const_iterator c = committed.begin(); c != committed.end(); c++)
+        notify_stored(*c);
+    
+    if (!failed.empty()) throw std::runtime_error("Could not rename " + failed + " into place");
+}
+
+//removes the temporary file of a file begun and not ended
+void    CAtomicWriter::abandon()
+{
+    if (open_file.fd < 0) return;
+    
+    ::close(open_file.fd);
+    std::remove(open_file.temporary.c_str());
+    open_file.fd = -1;
+}
+
+//removes the temporary files of a batch that could not be committed
+void    CAtomicWriter::discard()
+{
+    for (std::vector<staged_file>::const_iterator f = staged.begin(); f != staged.end(); f++)
+    {
+        if (f->fd >= 0) ::close(f->fd);
+        std::remove(f->temporary.c_str());
+    }
+    staged.clear();
+}
+
+//  =========================================================================================
+//  CFanOutWriter
+//  Files are placed in root_directory/xx/yy/, where xx and yy are taken from a hash of the file name,
+//  so that no directory holds more than a small share of a large corpus
+//  =========================================================================================
+
+CFanOutWriter::CFanOutWriter(const std::string& root_directory, const size_t batch_size)
+: CAtomicWriter(batch_size), root_directory(root_directory)
+{
+}
+
+std::string CFanOutWriter::location(const std::string& name) const
+{
+    std::string base_name = BaseName(name);
+    uint64_t    hash = HashBytes(base_name.data(), base_name.size());
+    char        directories[8];
+    
+    std::snprintf(directories, sizeof(directories), "%02x/%02x/", static_cast<unsigned>(hash & 0xff), static_cast<unsigned>((hash >> 8) & 0xff));
+    
+    return (root_directory.empty() || root_directory == "." ? "" : root_directory + "/") + directories + base_name;
+}
+
+void    CFanOutWriter::begin(const std::string& location)
+{
+    //create the directories leading to the file; those that already exist are left as they are
+    for (std::string::size_type slash = location.find('/', 1); slash != std::string::npos; slash = location.find('/', slash + 1))
+    {
+        mkdir(location.substr(0, slash).c_str(), 0755);
+    }
+    
+    CAtomicWriter::begin(location);
+}
+
+//  =========================================================================================
+//  CTarWriter
+//  Members are appended to a POSIX (ustar) archive as they are written, so an archive can be streamed
+//  to its destination. Each member is then recorded in the table of contents, archive_file.toc:
+//      member name - offset of its data in the archive - size of its data
+//  An archive that already exists is appended to, after the last member recorded in its table of
+//  contents; anything following that, such as the end of the archive or a member cut short by an
+//  interruption, is discarded. A member written in pieces is appended after a header giving its size
+//  as 0, which is filled in once the member is ended and before it is recorded in the table of contents.
+//  =========================================================================================
+
+static const size_t tar_block = 512;
+static const long long tar_mtime = 0;     //the same for every member, so that the same pieces always make the same archive
+
+//writes value as a zero padded octal number filling all but the last byte of field
+static void tar_octal(char* field, const size_t width, const long long value)
+{
+    std::snprintf(field, width, "%0*llo", static_cast<int>(width - 1), value);
+}
+
+CTarWriter::CTarWriter(const std::string& archive_file)
+: archive_file(archive_file)
+{
+    open_archive();
+}
+
+CTarWriter::~CTarWriter()
+{
+    close();
+}
+
+void    CTarWriter::open_archive()
+{
+    std::ifstream   old_toc ( (archive_file + ".toc").c_str() );
+    std::string     line;
+    struct stat     info;
+    long long       file_size = stat(archive_file.c_str(), &info) == 0 ? info.st_size : 0;
+    
+    while (old_toc)
+    {
+        GETLINE(old_toc, line);
+        
+        char member[1024];
+        toc_entry entry;
+        
+        //member names may contain spaces, but not tabs
+        if (std::sscanf(line.c_str(), "%1023[^\t]\t%lld\t%lld", member, &entry.offset, &entry.size) == 3)
+        {
+            long long end = entry.offset + ((entry.size + tar_block - 1) / tar_block) * tar_block;
+            
+            if (end <= file_size)
+            {
+                members[member] = entry;
+                if (end > archive_size) archive_size = end;
+            }
+        }
+        line.clear();
+    }
+    
+    if (file_size != archive_size && truncate(archive_file.c_str(), archive_size) != 0)
+    {
+        members.clear();
+        archive_size = 0;
+    }
+    
+    //the table of contents is written again without members that were discarded, in archive order, and
+    //replaced whole as an MEI file is, so that an interruption leaves either the old table or the new one
+    std::map<long long, std::string> kept;
+    std::stringstream kept_toc;
+    
+    for (std::map<std::string, toc_entry>::const_iterator m = members.begin(); m != members.end(); m++)
+        kept[m->second.offset] = m->first;
+    
+    for (std::map<long long, std::string>::const_iterator k = kept.begin(); k != kept.end(); k++)
+        kept_toc << k->second << '\t' << k->first << '\t' << members[k->second].size << '\n';
+    
+    CAtomicWriter toc_writer(1);
+    toc_writer.write(archive_file + ".toc", kept_toc.str());
+    
+    //members written from now on are appended to both
+    archive.open(archive_file.c_str(), std::ios::binary | (archive_size ? std::ios::app : std::ios::trunc));
+    toc.open((archive_file + ".toc").c_str(), std::ios::app);
+    
+    if (!archive.is_open() || !toc.is_open()) throw std::runtime_error("Could not open archive " + archive_file);
+}
+
+//members are named as the files would be, but relative to the archive
+std::string CTarWriter::location(const std::string& name) const
+{
+    std::string::size_type start = 0;
+    while (name.compare(start, 2, "./") == 0) start += 2;
+    
+    return archive_file + "/" + name.substr(start);
+}
+
+std::string CTarWriter::member_name(const std::string& location) const
+{
+    return location.substr(archive_file.size() + 1);
+}
+
+//fills block with the header of a member of size bytes
+void    CTarWriter::header(const std::string& member, const long long size, char* block) const
+{
+    std::memset(block, 0, tar_block);
+    
+    //names longer than 100 characters are split at a directory into prefix and name
+    std::string::size_type split = 0;
+    if (member.size() > 100)
+    {
+        split = member.find('/', member.size() - 101);
+        if (split == std::string::npos || split > 155) throw std::runtime_error("Name too long for archive: " + member);
+        std::memcpy(block + 345, member.data(), split);
+        split++;
+    }
+    std::memcpy(block, member.data() + split, member.size() - split);
+    
+    tar_octal(block + 100, 8, 0644);                        //mode
+    tar_octal(block + 108, 8, 0);                           //uid
+    tar_octal(block + 116, 8, 0);                           //gid
+    tar_octal(block + 124, 12, size);                       //size
+    tar_octal(block + 136, 12, tar_mtime);                  //mtime
+    block[156] = '0';                                       //regular file
+    std::memcpy(block + 257, "ustar", 6);
+    std::memcpy(block + 263, "00", 2);
+    
+    //checksum is calculated with its own field filled with spaces
+    std::memset(block + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (size_t i = 0; i < tar_block; i++) checksum += static_cast<unsigned char>(block[i]);
+    std::snprintf(block + 148, 7, "%06o", checksum);
+}
+
+void    CTarWriter::write(const std::string& location, const std::string& text)
+{
+    abandon();
+    
+    char block[tar_block];
+    header(member_name(location), static_cast<long long>(text.size()), block);
+    
+    archive.write(block, tar_block);
+    archive.write(text.data(), text.size());
+    
+    finish_member(location, static_cast<long long>(text.size()));
+}
+
+void    CTarWriter::begin(const std::string& location)
+{
+    abandon();
+    
+    char block[tar_block];
+    header(member_name(location), 0, block);
+    
+    archive.write(block, tar_block);
+    if (!archive) throw std::runtime_error("Could not write archive " + archive_file);
+    
+    open_location = location;
+    open_size = 0;
+}
+
+void    CTarWriter::append(const std::string& text)
+{
+    if (open_location.empty()) throw std::logic_error("No member begun to append to");
+    
+    archive.write(text.data(), text.size());
+    if (!archive) throw std::runtime_error("Could not write archive " + archive_file);
+    
+    open_size += text.size();
+}
+
+void    CTarWriter::end()
+{
+    if (open_location.empty()) throw std::logic_error("No member begun to end");
+    
+    std::string location;
+    location.swap(open_location);
+    
+    char block[tar_block];
+    header(member_name(location), open_size, block);
+    
+    //the header is written over once what precedes it is in the file
+    archive.flush();
+    int fd = ::open(archive_file.c_str(), O_WRONLY);
+    bool written = archive && fd >= 0 && pwrite(fd, block, tar_block, archive_size) == static_cast<ssize_t>(tar_block);
+    if (fd >= 0) ::close(fd);
+    
+    if (!written) throw std::runtime_error("Could not write archive " + archive_file);
+    
+    finish_member(location, open_size);
+}
+
+//cuts off a member begun and never ended, as when its conversion failed
+void    CTarWriter::abandon()
+{
+    if (open_location.empty()) return;
+    
+    open_location.clear();
+    archive.flush();
+    
+    if (truncate(archive_file.c_str(), archive_size) != 0) throw std::runtime_error("Could not write archive " + archive_file);
+}
+
+//pads the member just written to a whole number of blocks and records it
+void    CTarWriter::finish_member(const std::string& location, const long long size)
+{
+    static const char padding[tar_block] = { 0 };
+    size_t padded = (tar_block - size % tar_block) % tar_block;
+    
+    archive.write(padding, padded);
+    archive.flush();
+    
+    if (!archive) throw std::runtime_error("Could not write archive " + archive_file);
+    
+    std::string member = member_name(location);
+    toc_entry entry = { archive_size + static_cast<long long>(tar_block), size };
+    members[member] = entry;
+    archive_size += tar_block + size + padded;
+    
+    toc << member << '\t' << entry.offset << '\t' << entry.size << '\n';
+    toc.flush();
+    
+    notify_stored(location);
+}
+
+const bool CTarWriter::exists(const std::string& location) const
+{
+    if (location.compare(0, archive_file.size() + 1, archive_file + "/") != 0) return false;
+    
+    return members.count(member_name(location)) > 0;
+}
+
+//ends the archive with two empty blocks
+void    CTarWriter::close()
+{
+    if (!archive.is_open()) return;
+    
+    abandon();
+    
+    static const char end[2 * tar_block] = { 0 };
+    
+    archive.write(end, sizeof(end));
+    archive.close();
+    toc.close();
+}
+
+//  =========================================================================================
+//  CCompressingWriter
+//  Files are compressed one at a time by a writer thread while conversion continues. Each is a
+//  complete gzip (.gz) or zstd (.zst) file, so archives and fan-outs of compressed files remain usable.
+//  =========================================================================================
+
+CCompressingWriter::CCompressingWriter(CMEIWriter* output, const compression_t method, const int level, const size_t queue_limit)
+: output(output), method(method), level(level), queue_limit(queue_limit)
+{
+#ifndef HAVE_ZSTD
+    if (method == zstd_compression) throw std::logic_error("zstd compression is not available in this build");
+#endif
+    if (level < 1 || level > max_level(method)) throw std::logic_error("Bad compression level " + std::to_string(level));
+    worker = std::thread(&CCompressingWriter::run, this);
+}
+
+CCompressingWriter::~CCompressingWriter()
+{
+    try {
+        close();
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    delete output;
+}
+
+const int CCompressingWriter::max_level(const compression_t method)
+{
+#ifdef HAVE_ZSTD
+    if (method == zstd_compression) return ZSTD_maxCLevel();
+#endif
+    return method == zstd_compression ? 22 : Z_BEST_COMPRESSION;
+}
+
+std::string CCompressingWriter::location(const std::string& name) const
+{
+    return output->location(name + (method == zstd_compression ? ".zst" : ".gz"));
+}
+
+void    CCompressingWriter::write(const std::string& location, const std::string& text)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    
+    changed.wait(guard, [this] { return queue.size() < queue_limit || error; });
+    rethrow();
+    
+    queue.push_back(std::make_pair(location, text));
+    changed.notify_all();
+}
+
+//files are stored by the writer receiving them, in its own time
+void    CCompressingWriter::on_stored(const stored_handler& handler)
+{
+    std::lock_guard<std::mutex> guard(output_lock);
+    
+    output->on_stored(handler);
+}
+
+const bool CCompressingWriter::exists(const std::string& location) const
+{
+    std::lock_guard<std::mutex> guard(output_lock);
+    
+    return output->exists(location);
+}
+
+//waits until every file has been compressed and written
+void    CCompressingWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closing) return;
+        closing = true;
+        changed.notify_all();
+    }
+    
+    worker.join();
+    output->close();
+    
+    std::lock_guard<std::mutex> guard(lock);
+    rethrow();
+}
+
+void    CCompressingWriter::rethrow()
+{
+    if (error)
+    {
+        std::exception_ptr failure = error;
+        error = std::exception_ptr();
+        std::rethrow_exception(failure);
+    }
+}
+
+void    CCompressingWriter::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    
+    while (true)
+    {
+        changed.wait(guard, [this] { return !queue.empty() || closing; });
+        
+        if (queue.empty()) return;
+        
+        std::pair<std::string, std::string> file;
+        file.swap(queue.front());
+        queue.pop_front();
+        changed.notify_all();
+        
+        guard.unlock();
+        try {
+            std::string compressed = compress(file.second);
+            std::lock_guard<std::mutex> output_guard(output_lock);
+            output->write(file.first, compressed);
+        } catch (...) {
+            std::lock_guard<std::mutex> error_guard(lock);
+            if (!error) error = std::current_exception();
+        }
+        guard.lock();
+        changed.notify_all();
+    }
+}
+
+std::string CCompressingWriter::compress(const std::string& text) const
+{
+    std::string compressed;
+    
+#ifdef HAVE_ZSTD
+    if (method == zstd_compression)
+    {
+        compressed.resize(ZSTD_compressBound(text.size()));
+        size_t size = ZSTD_compress(&compressed[0], compressed.size(), text.data(), text.size(), level);
+        if (ZSTD_isError(size)) throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(size));
+        compressed.resize(size);
+        return compressed;
+    }
+#endif
+    
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    
+    //window bits of 15 + 16 select a gzip header and trailer
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) throw std::runtime_error("gzip compression failed");
+    
+    compressed.resize(deflateBound(&stream, text.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    stream.avail_in = static_cast<uInt>(text.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    
+    int result = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    
+    if (result != Z_STREAM_END) throw std::runtime_error("gzip compression failed");
+    
+    return compressed;
+}
+
+#ifdef HAVE_LIBURING
+//  =========================================================================================
+//  CUringWriter
+//  Each file is opened under its temporary name (see CAtomicWriter) when it is written, but its
+//  contents are queued and submitted to the kernel with those of other files, batch_size at a time,
+//  each write linked to an fsync of its file. Conversion continues while the kernel writes; writes
+//  are only waited for when too many are in flight, or when the writer is closed. A file whose write
+//  and fsync are complete is renamed into place, and once batch_size files have been renamed, their
+//  directories are synced and they are reported stored.
+//  =========================================================================================
+
+CUringWriter::CUringWriter(const size_t batch_size)
+: batch_size(batch_size ? batch_size : 1)
+{
+    //a write and its fsync take two entries
+    int result = io_uring_queue_init(static_cast<unsigned>(2 * this->batch_size), &ring, 0);
+    
+    if (result < 0) throw std::runtime_error(std::string("io_uring is not available: ") + std::strerror(-result));
+    ring_open = true;
+}
+
+CUringWriter::~CUringWriter()
+{
+    try {
+        close();
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void    CUringWriter::write(const std::string& location, const std::string& text)
+{
+    if (!ring_open) throw std::logic_error("Writer already closed");
+    
+    //no more than two batches are in flight at once
+    if (queued == batch_size) submit();
+    complete(batch_size);
+    
+    pending_write& file = writes[next_write];
+    
+    file.location = location;
+    file.temporary = temporary_name(location);
+    file.text = text;
+    file.fd = ::open(file.temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    
+    if (file.fd < 0)
+    {
+        writes.erase(next_write);
+        throw std::runtime_error("Could not write " + location);
+    }
+    
+    //a submission queue filled by writes not yet submitted is emptied by submitting them
+    try {
+        if (io_uring_sq_space_left(&ring) < 2 && queued) submit();
+        if (io_uring_sq_space_left(&ring) < 2) throw std::runtime_error("io_uring submission queue is full");
+    } catch (...) {
+        ::close(file.fd);
+        std::remove(file.temporary.c_str());
+        writes.erase(next_write);
+        throw;
+    }
+    
+    //the fsync is linked so that it starts once the write is complete, and is cancelled if it is not
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_write(sqe, file.fd, file.text.data(), static_cast<unsigned>(file.text.size()), 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(2 * next_write)));
+    
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_fsync(sqe, file.fd, 0);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(2 * next_write + 1)));
+    
+    next_write++;
+    queued++;
+}
+
+void    CUringWriter::submit()
+{
+    if (!queued) return;
+    
+    int result = io_uring_submit(&ring);
+    if (result < 0) throw std::runtime_error(std::string("io_uring submission failed: ") + std::strerror(-result));
+    queued = 0;
+}
+
+//waits until no more than limit writes are in flight; a file that cannot be written and renamed into
+//place is removed, and reported once the files renamed before it have been reported stored
+void    CUringWriter::complete(const size_t limit)
+{
+    while (writes.size() - queued > limit)
+    {
+        struct io_uring_cqe* cqe = NULL;
+        
+        int result = io_uring_wait_cqe(&ring, &cqe);
+        if (result < 0) throw std::runtime_error(std::string("io_uring failed: ") + std::strerror(-result));
+        
+        uint64_t    data = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+        int         res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        
+        std::map<uint64_t, pending_write>::iterator file = writes.find(data / 2);
+        if (file == writes.end()) continue;
+        
+        if (data % 2) file->second.synced = res;
+        else file->second.written = res;
+        
+        if (++file->second.completions < 2) continue;
+        
+        std::string location = file->second.location;
+        
+        if (!finish(data / 2))
+        {
+            publish();
+            throw std::runtime_error("Could not write " + location);
+        }
+        
+        renamed.push_back(location);
+        if (renamed.size() >= batch_size) publish();
+    }
+}
+
+//renames a file whose write and fsync are complete into place; a write cut short, which cancels its
+//fsync, is finished with pwrite and synced here
+const bool CUringWriter::finish(const uint64_t id)
+{
+    pending_write&  file = writes[id];
+    bool            stored = file.written >= 0;
+    size_t          done = stored ? static_cast<size_t>(file.written) : 0;
+    
+    if (stored && done < file.text.size())
+    {
+        while (done < file.text.size())
+        {
+            ssize_t more = pwrite(file.fd, file.text.data() + done, file.text.size() - done, static_cast<off_t>(done));
+            if (more < 0 && errno == EINTR) continue;
+            if (more <= 0) { stored = false; break; }
+            done += static_cast<size_t>(more);
+        }
+        stored = stored && fsync(file.fd) == 0;
+    }
+    else stored = stored && file.synced >= 0;
+    
+    ::close(file.fd);
+    stored = stored && std::rename(file.temporary.c_str(), file.location.c_str()) == 0;
+    
+    if (!stored) std::remove(file.temporary.c_str());
+    writes.erase(id);
+    
+    return stored;
+}
+
+//syncs the directories of the files renamed into place, then reports them stored
+void    CUringWriter::publish()
+{
+    std::vector<std::string> published;
+    
+    published.swap(renamed);
+    sync_directories(published);
+    
+    for (std::vector<std::string>::const_iterator p = published.begin(); p != published.end(); p++)
+        notify_stored(*p);
+}
+
+//removes the temporary files of writes that were never completed, once the ring is closed
+void    CUringWriter::discard()
+{
+    for (std::map<uint64_t, pending_write>::const_iterator f = writes.begin(); f != writes.end(); f++)
+    {
+        ::close(f->second.fd);
+        std::remove(f->second.temporary.c_str());
+    }
+    writes.clear();
+}
+
+//waits until every file has been written, renamed into place and reported stored
+void    CUringWriter::close()
+{
+    if (!ring_open) return;
+    
+    try {
+        submit();
+        complete(0);
+        publish();
+    } catch (...) {
+        ring_open = false;
+        io_uring_queue_exit(&ring);
+        discard();
+        throw;
+    }
+    ring_open = false;
+    io_uring_queue_exit(&ring);
+}
+#endif
@@ -0,0 +1,167 @@
+//
+//  CManifest.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  The manifest is a tab delimited file with the following columns:
+//      key - name of a Scribe file or of an MEI file written from it
+//      fingerprint - hexadecimal hash of everything the conversion depends upon
+//      owner - for MEI files, the Scribe file from which it was written
+//
+
+#include "CManifest.h"
+#include "CMEIWriter.h"
+#include <exception>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <utility>
+#include <iostream>
+
+
+CManifest::CManifest(const std::string& manifest_file)
+: manifest_file(manifest_file)
+{
+    load_manifest();
+}
+
+CManifest::~CManifest()
+{
+    save();
+}
+
+//  =========================================================================================
+//  load_manifest
+//  input: nil
+//  output: nil
+//  This function loads a previously saved manifest; a missing manifest is an empty one
+//  =========================================================================================
+
+void    CManifest::load_manifest()
+{
+    std::ifstream               file ( manifest_file.c_str() );
+    std::string                 line;
+    
+    if (!file.is_open()) return;
+    
+    while (file)
+    {
+        GETLINE(file, line);
+        std::stringstream lineStream(line);
+        std::string key, fingerprint, owner;
+        
+        if ( std::getline(lineStream, key, '\t') && std::getline(lineStream, fingerprint, '\t') ) //use the standard getline here - safe!
+        {
+            std::getline(lineStream, owner, '\t');
+            
+            manifest_entry entry;
+            entry.fingerprint = std::strtoull(fingerprint.c_str(), NULL, 16);
+            entry.owner = owner;
+            entries[key] = entry;
+        }
+        line.clear();
+    }
+}
+
+//  =========================================================================================
+//  is_current
+//  input: name of Scribe or MEI file, fingerprint of its present input
+//  output: true if the file was recorded with the same fingerprint
+//  =========================================================================================
+
+const bool CManifest::is_current(const std::string& key, const uint64_t fingerprint) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<std::string, manifest_entry>::const_iterator found = entries.find(key);
+    
+    return (found != entries.end() && found->second.fingerprint == fingerprint);
+}
+
+void    CManifest::update(const std::string& key, const uint64_t fingerprint, const std::string& owner)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    manifest_entry& entry = entries[key];
+    
+    if (entry.fingerprint != fingerprint || entry.owner != owner)
+    {
+        entry.fingerprint = fingerprint;
+        entry.owner = owner;
+        dirty = true;
+    }
+}
+
+//  =========================================================================================
+//  owned_by
+//  input: name of a Scribe file
+//  output: names of all MEI files recorded as written from it
+//  =========================================================================================
+
+std::vector<std::string> CManifest::owned_by(const std::string& owner) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::string> keys;
+    
+    for (std::map<std::string, manifest_entry>::const_iterator i = entries.begin(); i != entries.end(); i++)
+    {
+        if (i->second.owner == owner) keys.push_back(i->first);
+    }
+    
+    return keys;
+}
+
+std::vector<std::string> CManifest::keys() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::string> keys;
+    
+    for (std::map<std::string, manifest_entry>::const_iterator i = entries.begin(); i != entries.end(); i++)
+        keys.push_back(i->first);
+    
+    return keys;
+}
+
+const bool CManifest::lookup(const std::string& key, uint64_t& fingerprint, std::string& owner) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<std::string, manifest_entry>::const_iterator found = entries.find(key);
+    
+    if (found == entries.end()) return false;
+    
+    fingerprint = found->second.fingerprint;
+    owner = found->second.owner;
+    return true;
+}
+
+//  =========================================================================================
+//  save
+//  input: nil
+//  output: nil
+//  The manifest is written as an MEI file is, under a temporary name that is synced and renamed
+//  into place, so that an interrupted save leaves the previous manifest whole
+//  =========================================================================================
+
+void    CManifest::save()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (!dirty) return;
+    
+    std::stringstream text;
+    
+    for (std::map<std::string, manifest_entry>::const_iterator i = entries.begin(); i != entries.end(); i++)
+    {
+        text << i->first << '\t' << std::hex << i->second.fingerprint << std::dec << '\t' << i->second.owner << '\n';
+    }
+    
+    try {
+        CAtomicWriter file(1);
+        file.write(manifest_file, text.str());
+    } catch (std::exception&) {
+        std::cerr << "Could not save manifest " << manifest_file << std::endl;
+        return;
+    }
+    
+    dirty = false;
+}
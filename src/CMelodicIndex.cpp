@@ -0,0 +1,882 @@
+//
+//  CMelodicIndex.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CMelodicIndex.h"
+#include "CScribeCodes.h"
+#include "CScribeReaderVisitable.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static const char       index_magic[8] = { 'N', 'S', 'M', 'E', 'L', 'I', 'D', 'X' };
+static const uint32_t   index_version = 2;
+
+struct index_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    gram_length;
+    uint64_t    file_count;
+    uint64_t    part_count;
+    uint64_t    note_count;
+    uint64_t    key_count;
+    uint64_t    posting_count;
+    uint64_t    suffix_count;
+    uint64_t    names_size;     //bytes of the file names, which are not terminated
+};
+
+static inline uint64_t aligned(const uint64_t offset) { return (offset + 7) & ~static_cast<uint64_t>(7); }
+
+//offsets of the sections of an index file, each starting on a multiple of 8 bytes
+struct index_layout {
+    uint64_t    keys, offsets, postings, parts, notes, text, suffixes, lcp, name_offsets, names, size;
+    
+    index_layout(const index_header& header)
+    {
+        keys = aligned(sizeof(index_header));
+        offsets = aligned(keys + header.key_count * sizeof(uint32_t));
+        postings = aligned(offsets + (header.key_count + 1) * sizeof(uint32_t));
+        parts = aligned(postings + header.posting_count * 2 * sizeof(uint32_t));
+        notes = aligned(parts + header.part_count * sizeof(melodic_part));
+        text = notes + header.note_count * sizeof(melodic_note);
+        suffixes = aligned(text + header.note_count);
+        lcp = suffixes + header.suffix_count * sizeof(uint32_t);
+        name_offsets = aligned(lcp + header.suffix_count * sizeof(uint32_t));
+        names = name_offsets + (header.file_count + 1) * sizeof(uint64_t);
+        size = names + header.names_size;
+    }
+};
+
+//an interval as a byte of a key; 0 pads the n-grams cut short by the end of a part
+static inline uint32_t interval_byte(const int interval)
+{
+    return static_cast<uint32_t>(std::max(-127, std::min(127, interval)) + 128);
+}
+
+//key of an n-gram of count intervals, count being at most gram_length
+static inline uint32_t gram_key(const int* intervals, const size_t count)
+{
+    uint32_t key = 0;
+    
+    for (size_t k = 0; k < CMelodicIndexer::gram_length; k++)
+        key = (key << 8) | (k < count ? interval_byte(intervals[k]) : 0);
+    
+    return key;
+}
+
+//key of the n-gram starting at a position of the text of an index
+static inline uint32_t text_key(const uint8_t* text, const uint64_t position)
+{
+    uint32_t key = 0;
+    bool     ended = false;
+    
+    for (size_t k = 0; k < CMelodicIndexer::gram_length; k++)
+    {
+        ended = ended || text[position + k] == 0;
+        key = (key << 8) | (ended ? 0 : text[position + k]);
+    }
+    
+    return key;
+}
+
+//sorts items in up to jobs runs, each in a thread of its own, then merges the runs in pairs, also in threads of their own
+template <class T>
+static void parallel_sort(std::vector<T>& items, const size_t jobs)
+{
+    const size_t                runs = std::max<size_t>(1, std::min(jobs, items.size() / 65536 + 1));
+    std::vector<size_t>         bounds(runs + 1);
+    std::vector<std::thread>    threads;
+    
+    if (runs == 1)
+    {
+        std::sort(items.begin(), items.end());
+        return;
+    }
+    
+    for (size_t r = 0; r <= runs; r++) bounds[r] = items.size() * r / runs;
+    
+    for (size_t r = 0; r < runs; r++)
+        threads.push_back(std::thread([&items, &bounds, r]() { std::sort(items.begin() + bounds[r], items.begin() + bounds[r + 1]); }));
+    
+    for (std::vector<std::thread>::iterator t = threads.begin(); t != threads.end(); t++) t->join();
+    
+    for (size_t width = 1; width < runs; width *= 2)
+    {
+        threads.clear();
+        
+        for (size_t r = 0; r + width < runs; r += 2 * width)
+            threads.push_back(std::thread([&items, &bounds, r, width, runs]() {
+                std::inplace_merge(items.begin() + bounds[r], items.begin() + bounds[r + width], items.begin() + bounds[std::min(r + 2 * width, runs)]);
+            }));
+        
+        for (std::vector<std::thread>::iterator t = threads.begin(); t != threads.end(); t++) t->join();
+    }
+}
+
+//a suffix of the text by the ranks of its first k symbols and of the k after them
+struct suffix_rank {
+    uint64_t    ranks;
+    uint32_t    position;
+    
+    bool        operator<(const suffix_rank& rhs) const { return ranks < rhs.ranks; }
+};
+
+static inline bool posting_order(const melodic_posting& a, const melodic_posting& b)
+{
+    if (a.key != b.key) return a.key < b.key;
+    if (a.part != b.part) return a.part < b.part;
+    return a.note < b.note;
+}
+
+//  =========================================================================================
+//  melodic_segment
+//  =========================================================================================
+
+void    melodic_segment::clear()
+{
+    files.clear();
+    parts.clear();
+    notes.clear();
+    postings.clear();
+    text.clear();
+    suffixes.clear();
+    lcp.clear();
+}
+
+void    melodic_segment::sort()
+{
+    std::sort(postings.begin(), postings.end(), posting_order);
+}
+
+//  =========================================================================================
+//  merge
+//  input: sorted segments, which are emptied
+//  output: nil
+//  The segments are appended in the order given, their files, parts and notes numbered on from
+//  those of the segments before them. Their postings, already in order, are merged a key at a
+//  time; the postings of a key are taken from the earlier segment first, whose parts come first.
+//  Segments are expected to index different files.
+//  =========================================================================================
+
+void    melodic_segment::merge(std::vector<melodic_segment>& segments)
+{
+    std::vector<uint32_t>   part_base(segments.size());
+    std::vector<size_t>     head(segments.size(), 0);
+    size_t                  posting_count = 0;
+    
+    clear();
+    
+    for (size_t s = 0; s < segments.size(); s++)
+    {
+        const uint32_t file_base = static_cast<uint32_t>(files.size());
+        const uint64_t note_base = notes.size();
+        
+        part_base[s] = static_cast<uint32_t>(parts.size());
+        files.insert(files.end(), segments[s].files.begin(), segments[s].files.end());
+        
+        for (std::vector<melodic_part>::const_iterator p = segments[s].parts.begin(); p != segments[s].parts.end(); p++)
+        {
+            melodic_part part = { p->file + file_base, p->part, p->first_note + note_base };
+            parts.push_back(part);
+        }
+        
+        notes.insert(notes.end(), segments[s].notes.begin(), segments[s].notes.end());
+        posting_count += segments[s].postings.size();
+    }
+    
+    if (parts.size() > UINT32_MAX) throw std::runtime_error("Too many parts for a melodic index");
+    
+    postings.reserve(posting_count);
+    
+    for (;;)
+    {
+        size_t next = segments.size();
+        
+        for (size_t s = 0; s < segments.size(); s++)
+            if (head[s] < segments[s].postings.size() && (next == segments.size() || segments[s].postings[head[s]].key < segments[next].postings[head[next]].key))
+                next = s;
+        
+        if (next == segments.size()) break;
+        
+        const std::vector<melodic_posting>& from = segments[next].postings;
+        const uint32_t key = from[head[next]].key;
+        
+        for (; head[next] < from.size() && from[head[next]].key == key; head[next]++)
+        {
+            melodic_posting posting = from[head[next]];
+            posting.part += part_base[next];
+            postings.push_back(posting);
+        }
+    }
+    
+    for (size_t s = 0; s < segments.size(); s++) segments[s].clear();
+}
+
+//  =========================================================================================
+//  sort_suffixes
+//  input: worker threads to sort with
+//  output: nil
+//  Makes the text of the index from its postings, the first interval of each n-gram being the
+//  interval from its note, and sorts its suffixes by prefix doubling: once the suffixes are in
+//  order of their first k symbols, they are put in order of their first 2k by the ranks of both
+//  halves, until no two suffixes have the same rank. The end of each part is a symbol of its own,
+//  below every interval, so that no match runs from one part into the next; the suffixes starting
+//  there sort first and are left out. LCPs are found from the order in linear time (Kasai et al).
+//  =========================================================================================
+
+void    melodic_segment::sort_suffixes(const int jobs)
+{
+    if (notes.size() >= UINT32_MAX - 256) throw std::runtime_error("Too many notes for a melodic index");
+    
+    const uint32_t              length = static_cast<uint32_t>(notes.size());
+    std::vector<uint32_t>       rank(length);
+    std::vector<suffix_rank>    order(length);
+    uint32_t                    ends = 0, end = 0;
+    
+    text.assign(length, 0);
+    
+    for (std::vector<melodic_posting>::const_iterator p = postings.begin(); p != postings.end(); p++)
+        text[parts[p->part].first_note + p->note] = static_cast<uint8_t>(p->key >> 24);
+    
+    for (uint32_t i = 0; i < length; i++) if (!text[i]) ends++;
+    for (uint32_t i = 0; i < length; i++) rank[i] = text[i] ? ends + text[i] : end++;
+    
+    for (uint32_t k = 1; length; k *= 2)
+    {
+        for (uint32_t i = 0; i < length; i++)
+        {
+            order[i].ranks = (static_cast<uint64_t>(rank[i]) + 1) << 32 | (i + k < length ? rank[i + k] + 1 : 0);
+            order[i].position = i;
+        }
+        
+        parallel_sort(order, jobs > 0 ? jobs : 1);
+        
+        bool distinct = true;
+        
+        rank[order[0].position] = 0;
+        for (uint32_t j = 1; j < length; j++)
+        {
+            if (order[j].ranks == order[j - 1].ranks)
+            {
+                rank[order[j].position] = rank[order[j - 1].position];
+                distinct = false;
+            }
+            else
+                rank[order[j].position] = j;
+        }
+        
+        if (distinct || k >= length) break;
+    }
+    
+    //rank is now the place of each suffix in order
+    suffixes.resize(length - ends);
+    for (uint32_t j = ends; j < length; j++) suffixes[j - ends] = order[j].position;
+    
+    lcp.assign(length - ends, 0);
+    
+    for (uint32_t i = 0, common = 0; i < length; i++)
+    {
+        if (rank[i] <= ends)
+        {
+            common = 0;
+            continue;
+        }
+        
+        const uint32_t before = order[rank[i] - 1].position;
+        
+        while (text[i + common] && text[i + common] == text[before + common]) common++;
+        lcp[rank[i] - ends] = common;
+        if (common) common--;
+    }
+}
+
+//  =========================================================================================
+//  save
+//  input: name of the index file
+//  output: nil
+//  The index is written under a temporary name beside the file and renamed into place once
+//  complete, so that an index being searched is never seen half written.
+//  =========================================================================================
+
+void    melodic_segment::save(const std::string& index_file) const
+{
+    if (postings.size() > UINT32_MAX) throw std::runtime_error("Too many postings for a melodic index");
+    if (text.size() != notes.size()) throw std::logic_error("The suffixes of a melodic index are sorted before it is saved");
+    
+    std::vector<uint32_t>   keys, offsets, pairs;
+    std::vector<uint64_t>   name_offsets;
+    std::string             names;
+    
+    pairs.reserve(2 * postings.size());
+    
+    for (size_t p = 0; p < postings.size(); p++)
+    {
+        if (keys.empty() || keys.back() != postings[p].key)
+        {
+            keys.push_back(postings[p].key);
+            offsets.push_back(static_cast<uint32_t>(p));
+        }
+        pairs.push_back(postings[p].part);
+        pairs.push_back(postings[p].note);
+    }
+    offsets.push_back(static_cast<uint32_t>(postings.size()));
+    
+    for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); f++)
+    {
+        name_offsets.push_back(names.size());
+        names += *f;
+    }
+    name_offsets.push_back(names.size());
+    
+    index_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.gram_length = CMelodicIndexer::gram_length;
+    header.file_count = files.size();
+    header.part_count = parts.size();
+    header.note_count = notes.size();
+    header.key_count = keys.size();
+    header.posting_count = postings.size();
+    header.suffix_count = suffixes.size();
+    header.names_size = names.size();
+    
+    const index_layout  layout(header);
+    const std::string   temporary = index_file + ".partial";
+    std::ofstream       out(temporary.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    
+    if (!out.is_open()) throw std::runtime_error("Could not write melodic index " + index_file);
+    
+    //writes a section at its offset, padding the end of the section before it
+    uint64_t at = 0;
+    auto section = [&out, &at](const uint64_t offset, const void* data, const uint64_t size) {
+        static const char padding[8] = { 0 };
+        out.write(padding, static_cast<std::streamsize>(offset - at));
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        at = offset + size;
+    };
+    
+    section(0, &header, sizeof(header));
+    section(layout.keys, keys.data(), keys.size() * sizeof(uint32_t));
+    section(layout.offsets, offsets.data(), offsets.size() * sizeof(uint32_t));
+    section(layout.postings, pairs.data(), pairs.size() * sizeof(uint32_t));
+    section(layout.parts, parts.data(), parts.size() * sizeof(melodic_part));
+    section(layout.notes, notes.data(), notes.size() * sizeof(melodic_note));
+    section(layout.text, text.data(), text.size());
+    section(layout.suffixes, suffixes.data(), suffixes.size() * sizeof(uint32_t));
+    section(layout.lcp, lcp.data(), lcp.size() * sizeof(uint32_t));
+    section(layout.name_offsets, name_offsets.data(), name_offsets.size() * sizeof(uint64_t));
+    section(layout.names, names.data(), names.size());
+    
+    out.close();
+    
+    if (!out || std::rename(temporary.c_str(), index_file.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Could not write melodic index " + index_file);
+    }
+}
+
+//  =========================================================================================
+//  CMelodicIndexer
+//  =========================================================================================
+
+void    CMelodicIndexer::BeginFile(const CScribeReaderVisitable& scribe_data)
+{
+    codes = scribe_data.GetCodes();
+    segment.files.push_back(scribe_data.GetFileName());
+    part_number = 0;
+}
+
+void    CMelodicIndexer::IndexPart(const scribe_part& part)
+{
+    melodic_part indexed = { static_cast<uint32_t>(segment.files.size() - 1), ++part_number, segment.notes.size() };
+    
+    segment.parts.push_back(indexed);
+    current_part = &part;
+    row_number = 0;
+    steps.clear();
+}
+
+//a code followed by several pitches stands for as many notes, as does a ligature or neume
+void    CMelodicIndexer::IndexEvent(const scribe_event& event)
+{
+    event_number++;
+    
+    if (event.pitch_num.empty()) return;
+    
+    switch (codes->get_code_type(event.code))
+    {
+        case code_t::note:
+        case code_t::ligature:
+        case code_t::uneume:
+        case code_t::ineume:
+            break;
+        default:
+            return;
+    }
+    
+    const melodic_note note = { row_number, event_number };
+    
+    for (size_t k = 0; k < event.pitch_num.size(); k++)
+    {
+        steps.push_back(current_part->pitches[event.first_pitch + k].diatonic());
+        segment.notes.push_back(note);
+    }
+}
+
+//posts the n-gram starting at each note of the part but the last
+void    CMelodicIndexer::PostGrams()
+{
+    const uint32_t  part = static_cast<uint32_t>(segment.parts.size() - 1);
+    int             intervals[gram_length];
+    
+    for (size_t p = 0; p + 1 < steps.size(); p++)
+    {
+        const size_t count = std::min<size_t>(gram_length, steps.size() - 1 - p);
+        
+        for (size_t k = 0; k < count; k++) intervals[k] = steps[p + k + 1] - steps[p + k];
+        
+        melodic_posting posting = { gram_key(intervals, count), part, static_cast<uint32_t>(p) };
+        segment.postings.push_back(posting);
+    }
+}
+
+//===================================================================================================
+//
+//  Function:   Build
+//  Purpose:    Indexes files with up to jobs worker threads. Each worker reads and indexes a run of
+//              consecutive files into a segment of its own, and the segments are merged in order, so
+//              the index is the same whatever the number of workers
+//  Used by:    none - public function call
+//
+//===================================================================================================
+
+void CMelodicIndexer::Build(const std::vector<std::string>& files, const int jobs, melodic_segment& index)
+{
+    const size_t                    worker_count = std::max<size_t>(1, std::min<size_t>(jobs > 0 ? jobs : 1, files.size()));
+    std::vector<melodic_segment>    segments(worker_count);
+    std::vector<std::exception_ptr> errors(worker_count);
+    std::vector<std::thread>        workers;
+    
+    for (size_t w = 0; w < worker_count; w++)
+    {
+        workers.push_back(std::thread([&files, &segments, &errors, w, worker_count]() {
+            try {
+                CMelodicIndexer indexer;
+                CScribeTraversal<CMelodicIndexer> pass(indexer);
+                
+                for (size_t f = files.size() * w / worker_count; f < files.size() * (w + 1) / worker_count; f++)
+                {
+                    CScribeReaderVisitable scribe_data(files[f]);
+                    scribe_data.Accept(pass);
+                }
+                
+                indexer.segment.sort();
+                segments[w].files.swap(indexer.segment.files);
+                segments[w].parts.swap(indexer.segment.parts);
+                segments[w].notes.swap(indexer.segment.notes);
+                segments[w].postings.swap(indexer.segment.postings);
+            } catch (...) {
+                errors[w] = std::current_exception();
+            }
+        }));
+    }
+    
+    for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); w++) w->join();
+    
+    for (std::vector<std::exception_ptr>::const_iterator e = errors.begin(); e != errors.end(); e++)
+        if (*e) std::rethrow_exception(*e);
+    
+    index.merge(segments);
+}
+
+//  =========================================================================================
+//  CMelodicIndex
+//  =========================================================================================
+
+CMelodicIndex::CMelodicIndex(const std::string& index_file)
+: index_file(index_file)
+{
+    int fd = ::open(index_file.c_str(), O_RDONLY);
+    
+    if (fd < 0) throw std::runtime_error("Could not open melodic index " + index_file);
+    
+    struct stat info;
+    
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(index_header))
+    {
+        ::close(fd);
+        throw std::runtime_error(index_file + " is not a melodic index");
+    }
+    
+    mapping_size = static_cast<size_t>(info.st_size);
+    mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    
+    if (mapping == MAP_FAILED)
+    {
+        mapping = NULL;
+        throw std::runtime_error("Could not map melodic index " + index_file);
+    }
+    
+    const char*         base = static_cast<const char*>(mapping);
+    const index_header& header = *reinterpret_cast<const index_header*>(base);
+    
+    //counts are checked against the size of the file before the layout is worked out from them
+    bool valid = std::memcmp(header.magic, index_magic, sizeof(index_magic)) == 0 && header.version == index_version && header.gram_length == CMelodicIndexer::gram_length
+                 && header.file_count < mapping_size && header.part_count < mapping_size && header.note_count < mapping_size
+                 && header.key_count < mapping_size && header.posting_count < mapping_size && header.suffix_count <= header.note_count && header.names_size < mapping_size
+                 && index_layout(header).size == mapping_size;
+    
+    if (!valid)
+    {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+        throw std::runtime_error(index_file + " is not a melodic index of this version");
+    }
+    
+    const index_layout layout(header);
+    
+    gram_length = header.gram_length;
+    file_count = header.file_count;
+    part_count = header.part_count;
+    note_count = header.note_count;
+    key_count = header.key_count;
+    posting_count = header.posting_count;
+    suffix_count = header.suffix_count;
+    keys = reinterpret_cast<const uint32_t*>(base + layout.keys);
+    offsets = reinterpret_cast<const uint32_t*>(base + layout.offsets);
+    postings = reinterpret_cast<const posting*>(base + layout.postings);
+    parts = reinterpret_cast<const melodic_part*>(base + layout.parts);
+    notes = reinterpret_cast<const melodic_note*>(base + layout.notes);
+    text = reinterpret_cast<const uint8_t*>(base + layout.text);
+    suffixes = reinterpret_cast<const uint32_t*>(base + layout.suffixes);
+    lcp = reinterpret_cast<const uint32_t*>(base + layout.lcp);
+    name_offsets = reinterpret_cast<const uint64_t*>(base + layout.name_offsets);
+    names = base + layout.names;
+    
+    if (!Consistent(header.names_size))
+    {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+        throw std::runtime_error(index_file + " is damaged");
+    }
+    
+    //postings are read in scattered places by searches
+    madvise(mapping, mapping_size, MADV_RANDOM);
+}
+
+CMelodicIndex::~CMelodicIndex()
+{
+    if (mapping) munmap(mapping, mapping_size);
+}
+
+//checks that every offset, part, note and suffix held in the index is within the sections it refers to,
+//so that searches of an index damaged or cut short cannot read outside the file
+const bool CMelodicIndex::Consistent(const uint64_t names_size) const
+{
+    if (offsets[0] != 0 || offsets[key_count] != posting_count) return false;
+    
+    for (uint64_t k = 0; k < key_count; k++)
+        if (offsets[k] > offsets[k + 1]) return false;
+    
+    //parts are in order of their notes, which they share out from the first
+    for (uint64_t p = 0; p < part_count; p++)
+        if (parts[p].file >= file_count || parts[p].first_note > note_count || parts[p].first_note < (p ? parts[p - 1].first_note : 0) || (p == 0 && parts[p].first_note != 0)) return false;
+    
+    for (uint64_t p = 0; p < posting_count; p++)
+    {
+        if (postings[p].part >= part_count) return false;
+        
+        const uint64_t part_end = postings[p].part + 1 < part_count ? parts[postings[p].part + 1].first_note : note_count;
+        if (parts[postings[p].part].first_note + postings[p].note >= part_end) return false;
+    }
+    
+    //the text ends with the end of a part, at which every comparison of a suffix stops
+    if (note_count && text[note_count - 1] != 0) return false;
+    
+    for (uint64_t i = 0; i < suffix_count; i++)
+        if (suffixes[i] >= note_count) return false;
+    
+    if (name_offsets[0] != 0 || name_offsets[file_count] > names_size) return false;
+    
+    for (uint64_t f = 0; f < file_count; f++)
+        if (name_offsets[f] > name_offsets[f + 1]) return false;
+    
+    return true;
+}
+
+const std::string CMelodicIndex::FileName(const uint32_t file) const
+{
+    return std::string(names + name_offsets[file], static_cast<size_t>(name_offsets[file + 1] - name_offsets[file]));
+}
+
+//the keys from first_key to last_key, inclusive, that have postings, as indices [first, last) of keys
+void    CMelodicIndex::KeyRange(const uint32_t first_key, const uint32_t last_key, size_t& first, size_t& last) const
+{
+    first = static_cast<size_t>(std::lower_bound(keys, keys + key_count, first_key) - keys);
+    last = static_cast<size_t>(std::upper_bound(keys + first, keys + key_count, last_key) - keys);
+}
+
+//  =========================================================================================
+//  Find
+//  input: intervals of a fragment in diatonic steps, vector to fill with its hits
+//  output: nil
+//  A fragment of up to gram_length intervals is the beginning of the n-grams of a range of keys.
+//  A longer fragment is taken as n-grams every gram_length intervals, the last ending with the
+//  fragment; the hits of the first n-gram are kept where each of the others is posted at the same
+//  distance on in the same part. Hits are in order of part and note.
+//  =========================================================================================
+
+void    CMelodicIndex::Find(const std::vector<int>& intervals, std::vector<melodic_posting>& hits) const
+{
+    size_t first, last;
+    
+    hits.clear();
+    
+    if (intervals.empty()) throw std::runtime_error("A melodic fragment needs at least two notes");
+    
+    if (intervals.size() <= gram_length)
+    {
+        const uint32_t  shift = 8 * static_cast<uint32_t>(gram_length - intervals.size());
+        uint32_t        key = 0;
+        
+        for (size_t k = 0; k < intervals.size(); k++) key = (key << 8) | interval_byte(intervals[k]);
+        key <<= shift;
+        
+        KeyRange(key, key | ((1u << shift) - 1), first, last);
+        
+        for (size_t k = first; k < last; k++)
+            for (uint32_t p = offsets[k]; p < offsets[k + 1]; p++)
+            {
+                melodic_posting hit = { keys[k], postings[p].part, postings[p].note };
+                hits.push_back(hit);
+            }
+        
+        std::sort(hits.begin(), hits.end(), [](const melodic_posting& a, const melodic_posting& b) { return a.part != b.part ? a.part < b.part : a.note < b.note; });
+        return;
+    }
+    
+    const uint32_t key = gram_key(&intervals[0], gram_length);
+    
+    KeyRange(key, key, first, last);
+    
+    if (first == last) return;
+    
+    for (uint32_t p = offsets[first]; p < offsets[first + 1]; p++)
+    {
+        melodic_posting hit = { key, postings[p].part, postings[p].note };
+        hits.push_back(hit);
+    }
+    
+    for (size_t offset = gram_length; !hits.empty(); offset += gram_length)
+    {
+        offset = std::min(offset, intervals.size() - gram_length);
+        
+        const uint32_t later_key = gram_key(&intervals[offset], gram_length);
+        
+        KeyRange(later_key, later_key, first, last);
+        
+        if (first == last)
+        {
+            hits.clear();
+            break;
+        }
+        
+        const posting* later = postings + offsets[first];
+        const posting* later_end = postings + offsets[first + 1];
+        std::vector<melodic_posting>::iterator kept = hits.begin();
+        
+        for (std::vector<melodic_posting>::const_iterator hit = hits.begin(); hit != hits.end(); hit++)
+        {
+            const posting wanted = { hit->part, hit->note + static_cast<uint32_t>(offset) };
+            
+            later = std::lower_bound(later, later_end, wanted, [](const posting& a, const posting& b) { return a.part != b.part ? a.part < b.part : a.note < b.note; });
+            
+            if (later != later_end && later->part == wanted.part && later->note == wanted.note) *kept++ = *hit;
+        }
+        hits.erase(kept, hits.end());
+        
+        if (offset == intervals.size() - gram_length) break;
+    }
+}
+
+//extends common, the intervals a fragment is known to share with the text from suffix, as far as they agree;
+//the end of a part agrees with no interval
+size_t  CMelodicIndex::Common(const uint32_t suffix, const uint8_t* fragment, const size_t length, size_t common) const
+{
+    while (common < length && text[suffix + common] == fragment[common]) common++;
+    return common;
+}
+
+//  =========================================================================================
+//  Match
+//  input: intervals of a fragment in diatonic steps, vector to fill with its hits
+//  output: intervals of the fragment matched, from its start
+//  The suffixes are searched for the place of the fragment among them, comparing only from the
+//  intervals the fragment is known to share with both ends of the range still searched. The
+//  suffixes sharing the most with the fragment are on either side of that place, and those that
+//  share as much are next to them, as their LCPs show. If the whole fragment is found nowhere,
+//  the hits are the places where as much of its beginning as is found anywhere is found.
+//  Hits are in order of part and note.
+//  =========================================================================================
+
+size_t  CMelodicIndex::Match(const std::vector<int>& intervals, std::vector<melodic_posting>& hits) const
+{
+    hits.clear();
+    
+    if (intervals.empty()) throw std::runtime_error("A melodic fragment needs at least two notes");
+    
+    std::vector<uint8_t> fragment(intervals.size());
+    
+    for (size_t k = 0; k < intervals.size(); k++) fragment[k] = static_cast<uint8_t>(interval_byte(intervals[k]));
+    
+    const size_t    length = fragment.size();
+    size_t          low = 0, high = static_cast<size_t>(suffix_count);
+    size_t          low_common = 0, high_common = 0;    //shared with the suffixes before low and at high
+    
+    while (low < high)
+    {
+        const size_t middle = low + (high - low) / 2;
+        const size_t common = Common(suffixes[middle], fragment.data(), length, std::min(low_common, high_common));
+        
+        if (common == length || text[suffixes[middle] + common] > fragment[common])
+        {
+            high = middle;
+            high_common = common;
+        }
+        else
+        {
+            low = middle + 1;
+            low_common = common;
+        }
+    }
+    
+    size_t matched = 0, anchor = low;
+    
+    if (low < suffix_count) matched = Common(suffixes[low], fragment.data(), length, 0);
+    
+    if (low > 0)
+    {
+        const size_t before = Common(suffixes[low - 1], fragment.data(), length, 0);
+        if (before > matched)
+        {
+            matched = before;
+            anchor = low - 1;
+        }
+    }
+    
+    if (!matched) return 0;
+    
+    size_t first = anchor, last = anchor + 1;
+    
+    while (first > 0 && lcp[first] >= matched) first--;
+    while (last < suffix_count && lcp[last] >= matched) last++;
+    
+    std::vector<uint32_t> found(suffixes + first, suffixes + last);
+    std::sort(found.begin(), found.end());
+    
+    for (std::vector<uint32_t>::const_iterator position = found.begin(); position != found.end(); position++)
+    {
+        const melodic_part* part = std::upper_bound(parts, parts + part_count, *position, [](const uint32_t note, const melodic_part& p) { return note < p.first_note; }) - 1;
+        
+        melodic_posting hit = { text_key(text, *position), static_cast<uint32_t>(part - parts), static_cast<uint32_t>(*position - part->first_note) };
+        hits.push_back(hit);
+    }
+    
+    return matched;
+}
+
+//the postings of the index, with their keys, for merging with other segments
+void    CMelodicIndex::Load(melodic_segment& segment) const
+{
+    segment.clear();
+    
+    for (uint32_t f = 0; f < file_count; f++) segment.files.push_back(FileName(f));
+    
+    segment.parts.assign(parts, parts + part_count);
+    segment.notes.assign(notes, notes + note_count);
+    segment.postings.reserve(static_cast<size_t>(posting_count));
+    
+    for (size_t k = 0; k < key_count; k++)
+        for (uint32_t p = offsets[k]; p < offsets[k + 1]; p++)
+        {
+            melodic_posting posting = { keys[k], postings[p].part, postings[p].note };
+            segment.postings.push_back(posting);
+        }
+}
+
+//  =========================================================================================
+//  ParseFragment
+//  input: a fragment, as pitches - "d4 f4 g4 a4", or "d f g a" without octaves - or as intervals
+//         in diatonic steps - "+2 +1 +1"; vector to fill with its intervals
+//  output: nil
+//  Pitches given without octaves are taken to move by the smaller interval, a fourth at most.
+//  =========================================================================================
+
+void    CMelodicIndex::ParseFragment(const std::string& fragment, std::vector<int>& intervals)
+{
+    std::istringstream  in(fragment);
+    std::string         token;
+    int                 previous = 0;
+    int                 pitches = 0, octaves = 0;
+    
+    intervals.clear();
+    
+    while (in >> token)
+    {
+        const char name = static_cast<char>(std::tolower(token[0]));
+        
+        if (name >= 'a' && name <= 'g')
+        {
+            int step = (name - 'c' + 7) % 7;
+            
+            if (token.size() > 1)
+            {
+                if (token.find_first_not_of("0123456789", 1) != std::string::npos) throw std::runtime_error("Bad pitch " + token + " in melodic fragment");
+                step += 7 * std::atoi(token.c_str() + 1);
+                octaves++;
+            }
+            else if (pitches)
+            {
+                int up = ((step - previous) % 7 + 7) % 7;   //steps up to the nearest pitch of that name above
+                step = previous + (up > 3 ? up - 7 : up);
+            }
+            
+            if (pitches) intervals.push_back(step - previous);
+            previous = step;
+            pitches++;
+        }
+        else
+        {
+            char* end = NULL;
+            long interval = std::strtol(token.c_str(), &end, 10);
+            
+            if (*end != '\0') throw std::runtime_error("Bad interval " + token + " in melodic fragment");
+            intervals.push_back(static_cast<int>(interval));
+        }
+    }
+    
+    if (pitches && static_cast<size_t>(pitches) != intervals.size() + 1) throw std::runtime_error("A melodic fragment is either pitches or intervals");
+    if (octaves && octaves != pitches) throw std::runtime_error("Either every pitch of a melodic fragment has an octave or none has");
+    if (intervals.empty()) throw std::runtime_error("A melodic fragment needs at least two notes");
+}
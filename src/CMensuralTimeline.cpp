@@ -0,0 +1,204 @@
+//
+//  CMensuralTimeline.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CMensuralTimeline.h"
+#include "CScribeCodes.h"
+
+#include <cmath>
+#include <stdexcept>
+
+
+void    part_timeline::clear()
+{
+    part = NULL;
+    events.clear();
+    onset.clear();
+    duration.clear();
+    event.clear();
+    pitch.clear();
+}
+
+void    part_timeline::add(const int64_t at, const int32_t ticks, const uint32_t event_index, const int32_t pitch_index)
+{
+    onset.push_back(at);
+    duration.push_back(ticks);
+    event.push_back(event_index);
+    pitch.push_back(pitch_index);
+}
+
+CMensuralTimeline::CMensuralTimeline(const std::string& timeline_file)
+: timeline_file(timeline_file), output(timeline_file.c_str(), std::ios::out | std::ios::trunc)
+{
+    if (!output.is_open()) throw std::runtime_error("Could not open timeline file " + timeline_file);
+}
+
+void    CMensuralTimeline::BeginFile(const CScribeReaderVisitable& scribe_data)
+{
+    source = scribe_data.GetFileName();
+    codes = scribe_data.GetCodes();
+    part_count = 0;
+}
+
+void    CMensuralTimeline::EndFile(const CScribeReaderVisitable&)
+{
+    if (part_count) EndPiece();
+    codes = NULL;
+}
+
+//kind and duration in ticks of a code; the code table is the same for every trecento file, so both are kept once found
+const CMensuralTimeline::code_timing& CMensuralTimeline::timing(const std::string& code)
+{
+    std::unordered_map<std::string, code_timing>::iterator found = timings.find(code);
+    
+    if (found != timings.end()) return found->second;
+    
+    code_timing code_time = { codes->get_code_type(code), static_cast<int32_t>(std::lround(codes->duration(code) * ticks_per_breve)) };
+    
+    return timings.insert(std::make_pair(code, code_time)).first->second;
+}
+
+//parts with the same REPNUM make a piece, as when pieces are segmented; each part starts at the start of its piece
+void    CMensuralTimeline::TimePart(const scribe_part& part)
+{
+    if (part_count && part.rep_num != parts[0].part->rep_num) EndPiece();
+    
+    if (parts.size() == part_count) parts.push_back(part_timeline());
+    
+    parts[part_count].clear();
+    parts[part_count].part = &part;
+    part_count++;
+    now = 0;
+}
+
+void    CMensuralTimeline::TimeEvent(const scribe_event& event)
+{
+    part_timeline&      timeline = parts[part_count - 1];
+    const code_timing&  code_time = timing(event.code);
+    const uint32_t      index = static_cast<uint32_t>(timeline.events.size());
+    const int32_t       pitch_count = static_cast<int32_t>(event.pitch_num.size());
+    const int32_t       first_pitch = static_cast<int32_t>(event.first_pitch);
+    
+    timeline.events.push_back(&event);
+    
+    switch (code_time.type)
+    {
+        case code_t::note:
+        case code_t::uneume:
+        case code_t::ineume:
+        {
+            //a code followed by several pitches stands for as many notes
+            for (int32_t k = 0; k < pitch_count; k++, now += code_time.ticks)
+                timeline.add(now, code_time.ticks, index, first_pitch + k);
+            
+            if (!pitch_count)
+            {
+                timeline.add(now, code_time.ticks, index, -1);
+                now += code_time.ticks;
+            }
+            break;
+        }
+        case code_t::ligature:
+        {
+            for (int32_t k = 0; k < pitch_count; k++)
+            {
+                int32_t ticks = timing(CScribeReaderVisitable::get_ligature_code(event.code, k)).ticks;
+                timeline.add(now, ticks, index, first_pitch + k);
+                now += ticks;
+            }
+            break;
+        }
+        case code_t::rest:
+        {
+            int32_t ticks = code_time.ticks;
+            
+            //the generic rest stands for the rest of the same span on the staff (see Event of CScribeToNeoScribeXML)
+            if (event.code == "R" && pitch_count >= 2)
+            {
+                switch (event.pitch_num[1] - event.pitch_num[0])
+                {
+                    case minim_rest: ticks = timing("RM").ticks; break;
+                    case semibreve_rest: ticks = timing("RSP").ticks; break;
+                    case breve_rest: ticks = timing("RBI").ticks; break;
+                    case long_rest: ticks = timing("RLI").ticks; break;
+                    case perf_long_rest: ticks = timing("RLP").ticks; break;
+                    default: break;
+                }
+            }
+            
+            timeline.add(now, ticks, index, -1);
+            now += ticks;
+            break;
+        }
+        default:
+            timeline.add(now, 0, index, -1);
+            break;
+    }
+}
+
+//  =========================================================================================
+//  Merge
+//  input: timelines of the parts of a piece, number of them in use
+//  output: part and entry of every entry of the parts, in order of onset; entries with the same
+//  onset in the order of their parts, and within a part in their own order
+//  The parts of a piece are few, so the earliest of their next entries is found by comparing them.
+//  =========================================================================================
+
+void    CMensuralTimeline::Merge(const std::vector<part_timeline>& parts, const size_t part_count, std::vector<std::pair<uint32_t, uint32_t> >& order)
+{
+    std::vector<uint32_t> next(part_count, 0);
+    size_t total = 0;
+    
+    for (size_t p = 0; p < part_count; p++) total += parts[p].onset.size();
+    
+    order.clear();
+    order.reserve(total);
+    
+    while (order.size() < total)
+    {
+        size_t earliest = part_count;
+        
+        for (size_t p = 0; p < part_count; p++)
+        {
+            if (next[p] == parts[p].onset.size()) continue;
+            if (earliest == part_count || parts[p].onset[next[p]] < parts[earliest].onset[next[earliest]]) earliest = p;
+        }
+        
+        order.push_back(std::make_pair(static_cast<uint32_t>(earliest), next[earliest]++));
+    }
+}
+
+//writes the events of the piece in order of time
+void    CMensuralTimeline::EndPiece()
+{
+    Merge(parts, part_count, order);
+    
+    const std::string& rep_num = parts[0].part->rep_num;
+    std::string row;
+    
+    for (std::vector<std::pair<uint32_t, uint32_t> >::const_iterator o = order.begin(); o != order.end(); o++)
+    {
+        const part_timeline&    timeline = parts[o->first];
+        const scribe_event&     event = *timeline.events[timeline.event[o->second]];
+        const int32_t           pitch = timeline.pitch[o->second];
+        
+        row = source + '\t' + rep_num + '\t' + std::to_string(timeline.onset[o->second]) + '\t' + std::to_string(timeline.duration[o->second])
+            + '\t' + std::to_string(o->first + 1) + '\t' + CScribeCodes::voice_labels[timeline.part->voice_type] + '\t' + event.code + '\t';
+        
+        if (pitch >= 0)
+        {
+            row += timeline.part->pitches[pitch].name;
+            row += std::to_string(timeline.part->pitches[pitch].octave);
+        }
+        row += '\n';
+        output << row;
+    }
+    
+    entries += order.size();
+    pieces++;
+    part_count = 0;
+}
@@ -0,0 +1,243 @@
+//
+//  CPrefetcher.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CPrefetcher.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+CPrefetcher::CPrefetcher(const std::vector<std::string>& files, const io_backend_t backend, const size_t depth)
+: files(files), io(backend), depth(depth ? depth : 1)
+{
+#ifdef HAVE_LIBURING
+    if (io == uring_io)
+    {
+        int result = io_uring_queue_init(static_cast<unsigned>(this->depth), &ring, 0);
+        if (result < 0)
+        {
+            std::cerr << "io_uring is not available (" << std::strerror(-result) << "); reading with a thread instead." << std::endl;
+            io = threaded_io;
+        }
+    }
+#else
+    if (io == uring_io) io = threaded_io;
+#endif
+    
+    if (io == threaded_io) reader = std::thread(&CPrefetcher::run, this);
+}
+
+CPrefetcher::~CPrefetcher()
+{
+    if (io == threaded_io)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            changed.notify_all();
+        }
+        reader.join();
+    }
+#ifdef HAVE_LIBURING
+    if (io == uring_io)
+    {
+        //reads still in flight must finish before their buffers are released
+        while (in_flight) complete_read();
+        for (std::deque<pending_read>::iterator p = pending.begin(); p != pending.end(); p++)
+            if (p->fd >= 0) ::close(p->fd);
+        io_uring_queue_exit(&ring);
+    }
+#endif
+}
+
+//reads a whole file into file.contents, as read_scribe_buffer would
+bool CPrefetcher::read_file(prefetched_file& file)
+{
+    std::ifstream in(file.name, std::ios::in | std::ios::binary);
+    
+    if (!in.is_open()) return false;
+    
+    in.seekg(0, in.end);
+    std::streamoff length = in.tellg();
+    in.seekg(0, in.beg);
+    
+    file.contents.resize(static_cast<size_t>(length));
+    if (length > 0) in.read(&file.contents[0], length);
+    
+    return static_cast<bool>(in);
+}
+
+//hands out the next file of the batch; false once every file has been handed out
+bool CPrefetcher::next(prefetched_file& file)
+{
+    if (next_file >= files.size()) return false;
+    
+    if (io == blocking_io)
+    {
+        file.name = files[next_file++];
+        file.found = read_file(file);
+        return true;
+    }
+    
+    if (io == threaded_io)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        
+        changed.wait(guard, [this] { return !ready.empty(); });
+        file = std::move(ready.front());
+        ready.pop_front();
+        next_file++;
+        changed.notify_all();
+        return true;
+    }
+
+#ifdef HAVE_LIBURING
+    submit_reads();
+    
+    //reads complete in any order; wait for the one needed now, keeping the others until they are needed
+    while (pending.front().fd >= 0) complete_read();
+    
+    file = std::move(ready.front());
+    ready.pop_front();
+    pending.pop_front();
+    next_file++;
+    
+    //replace the file handed out, so that depth reads stay ahead of conversion
+    submit_reads();
+#endif
+    
+    return true;
+}
+
+//  =========================================================================================
+//  threaded_io
+//  =========================================================================================
+
+void    CPrefetcher::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    
+    while (next_read < files.size())
+    {
+        changed.wait(guard, [this] { return ready.size() < depth || stopping; });
+        
+        if (stopping) return;
+        
+        prefetched_file file;
+        file.name = files[next_read++];
+        
+        guard.unlock();
+        file.found = read_file(file);
+        guard.lock();
+        
+        ready.push_back(std::move(file));
+        changed.notify_all();
+    }
+}
+
+#ifdef HAVE_LIBURING
+//  =========================================================================================
+//  uring_io
+//  Files are opened and sized as they are queued, then their reads are submitted to the kernel
+//  in a single call. Each read is identified by its file's place in the batch.
+//  =========================================================================================
+
+void    CPrefetcher::submit_reads()
+{
+    size_t queued = 0;
+    
+    while (next_read < files.size() && ready.size() < depth)
+    {
+        prefetched_file file;
+        pending_read    read = { -1, 0 };
+        struct stat     info;
+        
+        file.name = files[next_read];
+        read.fd = ::open(file.name.c_str(), O_RDONLY);
+        
+        if (read.fd >= 0 && fstat(read.fd, &info) == 0)
+        {
+            file.contents.resize(static_cast<size_t>(info.st_size));
+            file.found = true;
+        }
+        else if (read.fd >= 0)
+        {
+            ::close(read.fd);
+            read.fd = -1;
+        }
+        
+        ready.push_back(std::move(file));
+        pending.push_back(read);
+        
+        if (read.fd >= 0 && ready.back().contents.empty())
+        {
+            //nothing to read
+            ::close(pending.back().fd);
+            pending.back().fd = -1;
+        }
+        else if (read.fd >= 0)
+        {
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            if (!sqe) throw std::runtime_error("io_uring submission queue is full");
+            
+            io_uring_prep_read(sqe, read.fd, &ready.back().contents[0], static_cast<unsigned>(ready.back().contents.size()), 0);
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(next_read)));
+            queued++;
+        }
+        next_read++;
+    }
+    
+    if (queued)
+    {
+        int result = io_uring_submit(&ring);
+        if (result < 0) throw std::runtime_error(std::string("io_uring submission failed: ") + std::strerror(-result));
+        in_flight += queued;
+    }
+}
+
+//waits for a read to complete; a read cut short is finished with pread
+void    CPrefetcher::complete_read()
+{
+    struct io_uring_cqe* cqe = NULL;
+    
+    if (!in_flight) return;
+    
+    int result = io_uring_wait_cqe(&ring, &cqe);
+    if (result < 0) throw std::runtime_error(std::string("io_uring failed: ") + std::strerror(-result));
+    
+    size_t  index = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+    int     read_result = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+    in_flight--;
+    
+    prefetched_file&    file = ready[index - next_file];
+    pending_read&       read = pending[index - next_file];
+    
+    if (read_result < 0)
+        file.found = false;
+    else
+    {
+        read.done = static_cast<size_t>(read_result);
+        while (read.done < file.contents.size())
+        {
+            ssize_t more = pread(read.fd, &file.contents[read.done], file.contents.size() - read.done, static_cast<off_t>(read.done));
+            if (more <= 0) break;
+            read.done += static_cast<size_t>(more);
+        }
+        file.contents.resize(read.done);
+    }
+    
+    ::close(read.fd);
+    read.fd = -1;
+}
+#endif
@@ -33,6 +33,7 @@
 #include <string>
 #include <sstream>
 #include <utility>
+#include <cstdlib>
 #include <iostream>
 
 std::unordered_map<int,std::string> CScribeCodes::voice_labels({{ voice_type::unlabelled, "unlabelled" }, { voice_type::cantus, "cantus" }, { voice_type::contratenor,"contratenor" }, { voice_type::tenor,"tenor" }, { voice_type::tenor2, "tenor 2"}, { voice_type::triplum, "triplum" } });
@@ -103,6 +104,7 @@ void    CScribeCodes::load_csv_table(const std::string &csv_file)
                 is_pitch_code = true;
             else is_pitch_code = false;
             code_pitchcode_map.insert(std::make_pair(key, is_pitch_code));
+            code_duration_map.insert(std::make_pair(key, std::atof((*i)[14].c_str())));
             
             if (mei_type.empty()) {
                 std::cout << "Error. Empty mei type" << std::endl;
@@ -126,7 +128,7 @@ void    CScribeCodes::load_csv_table(const std::string &csv_file)
 //  output: string reference contain the name of the notational element for use in XML
 //  =========================================================================================
 
-const std::string& CScribeCodes::code_to_name(const std::string code) const
+const std::string& CScribeCodes::code_to_name(const std::string& code) const
 {
     return code_name_map.at(code);
 }
@@ -155,10 +157,24 @@ const bool CScribeCodes::is_pitched_code(const std::string& code) const
     return is_pitched;
 }
 
+//  =========================================================================================
+//  duration
+//  input: string reference containing the SCRIBE code for a notational element
+//  output: duration of the element in breves, from the duration column; 0 if it has none
+//  =========================================================================================
+
+const double CScribeCodes::duration(const std::string& code) const
+{
+    std::unordered_map<std::string, double>::const_iterator found = code_duration_map.find(code);
+    
+    return found == code_duration_map.end() ? 0 : found->second;
+}
+
 CScribeCodes&   CScribeCodes::operator=(const CScribeCodes& rhs)
 {
     code_matrix = rhs.code_matrix;
     code_name_map = rhs.code_name_map;
+    code_duration_map = rhs.code_duration_map;
     code_types = rhs.code_types;
     
     return *this;
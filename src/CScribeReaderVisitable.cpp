@@ -11,6 +11,12 @@
     12 JAN  2014:   Scribe2MEIXML function split into sub routines to permit addition call functions
     9  FEB  2014:   Converted into a visitable class, removing NeoScribeXML extraction routines to 
                     CNeoScribeXML (a visitor)
+    18 OCT  2026:   File buffered and split into parts by byte range; parts hashed so that Reload only
+                    reparses modified parts
+    18 OCT  2026:   gzip and zstd compressed Scribe files read directly, decompressing into the buffer
+    18 OCT  2026:   Reader may be given the contents of a file already read
+    18 OCT  2026:   Compound neumes found from gaps between events as each row is read
+    18 OCT  2026:   Pitches of each part resolved under the clef in force once, when the part is read
 
     To do:
     
@@ -21,34 +27,218 @@
 #include <exception>
 #include <sstream>
 #include <iterator>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstring>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include "Header.h"
 
 
 CScribeReaderVisitable::CScribeReaderVisitable(const std::string& scribe_file_name)
-: file(scribe_file_name)
+: file_name(scribe_file_name)
 {
     trecento_codes = new CScribeCodes(PROCWORKINGDIRECTORY + TRECENTO_CODES_CSV);
     chant_codes = new CScribeCodes(PROCWORKINGDIRECTORY + CHANT_CODES_CSV);
-    if (file.is_open())
+    if (read_scribe_buffer())
     {
-        read_header();
-        if (is_scribe_file()) load_scribe_file();
+        std::stringstream in(buffer);
+        read_header(in);
+        if (is_scribe_file()) load_scribe_file(false, type);
     }
     else
         std::cout << "Could not open nominated Scribe file.";
 }
 
+//for a file whose contents have already been read, eg. by a CPrefetcher; contents are taken over by the reader
+CScribeReaderVisitable::CScribeReaderVisitable(const std::string& scribe_file_name, std::string& contents)
+: file_name(scribe_file_name)
+{
+    trecento_codes = new CScribeCodes(PROCWORKINGDIRECTORY + TRECENTO_CODES_CSV);
+    chant_codes = new CScribeCodes(PROCWORKINGDIRECTORY + CHANT_CODES_CSV);
+    read_scribe_buffer(contents);
+    
+    std::stringstream in(buffer);
+    read_header(in);
+    if (is_scribe_file()) load_scribe_file(false, type);
+}
+
 CScribeReaderVisitable::~CScribeReaderVisitable()
 {
     delete trecento_codes;
     delete chant_codes;
-    file.close();
 }
 
-scribe_type  CScribeReaderVisitable::read_header()
+//reads the whole Scribe file into buffer so that parts can be located and hashed by byte range
+//gzip and zstd compressed files, recognised by their first bytes, are decompressed into buffer as they are read;
+//content_hash is always of the file as stored, so that it matches HashFile
+bool CScribeReaderVisitable::read_scribe_buffer()
+{
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    
+    if (!file.is_open()) return false;
+    
+    char magic[4] = { 0 };
+    file.read(magic, sizeof(magic));
+    file_compression_t compression = compression_of(magic, static_cast<size_t>(file.gcount()));
+    file.clear();
+    file.seekg(0, file.beg);
+    
+    if (compression == no_compression)
+    {
+        file.seekg(0, file.end);
+        std::streamoff length = file.tellg();
+        file.seekg(0, file.beg);
+        
+        buffer.resize(static_cast<size_t>(length));
+        if (length > 0) file.read(&buffer[0], length);
+        
+        content_hash = HashBytes(buffer.data(), buffer.size());
+    }
+    else
+        decompress(file, compression);
+    
+    return true;
+}
+
+//as above, but for a file already read by the caller; contents are taken over rather than copied
+void CScribeReaderVisitable::read_scribe_buffer(std::string& contents)
+{
+    file_compression_t compression = compression_of(contents.data(), contents.size());
+    
+    if (compression == no_compression)
+    {
+        buffer.swap(contents);
+        content_hash = HashBytes(buffer.data(), buffer.size());
+    }
+    else
+    {
+        std::istringstream in(contents);
+        decompress(in, compression);
+    }
+    contents.clear();
+}
+
+CScribeReaderVisitable::file_compression_t CScribeReaderVisitable::compression_of(const char* start, const size_t length)
+{
+    const unsigned char* magic = reinterpret_cast<const unsigned char*>(start);
+    
+    if (length >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return gzip_compressed;
+    if (length >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) return zstd_compressed;
+    
+    return no_compression;
+}
+
+void CScribeReaderVisitable::decompress(std::istream& file, const file_compression_t compression)
+{
+    buffer.clear();
+    content_hash = HASH_SEED;
+    
+    if (compression == gzip_compressed)
+        inflate_gzip(file);
+    else
+        decompress_zstd(file);
+}
+
+static const size_t decompression_chunk = 65536;
+
+//a gzip file may hold several members one after another, as written by concatenating gzip files
+void CScribeReaderVisitable::inflate_gzip(std::istream& file)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    
+    //window bits of 15 + 16 accept only a gzip header and trailer
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) throw std::runtime_error("Could not decompress " + file_name);
+    
+    std::vector<char> in(decompression_chunk);
+    int result = Z_OK;
+    bool full = false; //output filled, so inflate may have more to give without further input
+    
+    while (true)
+    {
+        if (stream.avail_in == 0 && !full)
+        {
+            file.read(&in[0], in.size());
+            stream.next_in = reinterpret_cast<Bytef*>(&in[0]);
+            stream.avail_in = static_cast<uInt>(file.gcount());
+            if (stream.avail_in == 0) break;
+            content_hash = HashBytes(&in[0], stream.avail_in, content_hash);
+        }
+        
+        size_t used = buffer.size();
+        buffer.resize(used + decompression_chunk);
+        stream.next_out = reinterpret_cast<Bytef*>(&buffer[used]);
+        stream.avail_out = static_cast<uInt>(decompression_chunk);
+        
+        result = inflate(&stream, Z_NO_FLUSH);
+        full = stream.avail_out == 0;
+        buffer.resize(used + decompression_chunk - stream.avail_out);
+        
+        if (result == Z_STREAM_END)
+        {
+            if (stream.avail_in == 0 && file.peek() == std::char_traits<char>::eof()) break;
+            inflateReset(&stream);
+            result = Z_OK;
+            full = false;
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+            break;
+    }
+    inflateEnd(&stream);
+    
+    if (result != Z_STREAM_END) throw std::runtime_error("Compressed Scribe file is damaged or incomplete: " + file_name);
+}
+
+void CScribeReaderVisitable::decompress_zstd(std::istream& file)
+{
+#ifdef HAVE_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    std::vector<char> in(ZSTD_DStreamInSize());
+    size_t pending = 0; //non-zero while a frame is unfinished
+    
+    ZSTD_initDStream(stream);
+    
+    while (file)
+    {
+        file.read(&in[0], in.size());
+        ZSTD_inBuffer input = { &in[0], static_cast<size_t>(file.gcount()), 0 };
+        content_hash = HashBytes(&in[0], input.size, content_hash);
+        
+        bool full = false; //output filled, so zstd may have more to give without further input
+        
+        while (input.pos < input.size || full)
+        {
+            size_t used = buffer.size();
+            buffer.resize(used + decompression_chunk);
+            ZSTD_outBuffer output = { &buffer[used], decompression_chunk, 0 };
+            
+            pending = ZSTD_decompressStream(stream, &output, &input);
+            
+            if (ZSTD_isError(pending))
+            {
+                ZSTD_freeDStream(stream);
+                throw std::runtime_error("Compressed Scribe file is damaged: " + file_name + " (" + ZSTD_getErrorName(pending) + ")");
+            }
+            full = output.pos == output.size;
+            buffer.resize(used + output.pos);
+        }
+    }
+    ZSTD_freeDStream(stream);
+    
+    if (pending != 0) throw std::runtime_error("Compressed Scribe file is incomplete: " + file_name);
+#else
+    (void)file;
+    throw std::logic_error("zstd compressed Scribe files cannot be read by this build: " + file_name);
+#endif
+}
+
+scribe_type  CScribeReaderVisitable::read_header(std::istream& in)
 {
     std::string h_line;
-    GETLINE(file,h_line);
+    GETLINE(in,h_line);
     
     //set type and point at codes
     if (h_line == scribe_chant)
@@ -69,145 +259,311 @@ scribe_type  CScribeReaderVisitable::read_header()
     return type;
 }
 
-//Primary function that reads in header and calls a function to read each row of a scribe file
-int CScribeReaderVisitable::load_scribe_file()
+//===================================================================================================
+//
+//  Function:   Reload
+//  Purpose:    Rereads the Scribe file from disk after it has been modified. Only parts whose bytes have
+//              changed are parsed again; the parsed model of unchanged parts is reused.
+//  Output:     partIDs of parts that were reparsed (also flagged as modified in each scribe_part)
+//  Used by:    none - public function call
+//
+//===================================================================================================
+const std::vector<int>& CScribeReaderVisitable::Reload()
 {
-    int numparts = 0;
-    scribe_part part;
-    std::string row;
-    std::string field;
-    std::string temp_title("");
+    scribe_type previous_type = type;
     
-    //read in second row containing metadata; header has already been read so file pointer should be pre-line 2 (checking required)
-    GETLINE(file,row);
+    changed_parts.clear();
     
-    while (file.good())
+    if (!read_scribe_buffer())
     {
-        std::stringstream lineStream(row);
+        std::cout << "Could not open nominated Scribe file.";
+        for (std::vector<scribe_part>::iterator part = parts.begin(); part != parts.end(); part++)
+            part->modified = false;
+        return changed_parts;
+    }
+    
+    std::stringstream in(buffer);
+    read_header(in);
+    
+    if (is_scribe_file()) load_scribe_file(type==previous_type, type);
+    
+    return changed_parts;
+}
+
+//Primary function that splits the buffered file into parts and calls a function to read each part
+//Each part starts with a metadata row ('>') and runs to the next metadata row; parts with the same hash
+//as a previously loaded part are reused if reuse_parts is set
+template <scribe_type notation>
+int CScribeReaderVisitable::load_scribe_file(const bool reuse_parts)
+{
+    std::vector<scribe_part> old_parts;
+    std::unordered_multimap<uint64_t, size_t> old_hashes;
+    
+    old_parts.swap(parts);
+    changed_parts.clear();
+    pieceCount = 0;
+    
+    if (reuse_parts)
+    {
+        for (size_t k = 0; k < old_parts.size(); ++k)
+            old_hashes.insert(std::make_pair(old_parts[k].content_hash, k));
+    }
+    
+    //find start of each metadata row; header has already been checked, so skip first line
+    std::vector<size_t> part_starts;
+    size_t pos = 0;
+    size_t header_end = 0;
+    bool line_start = false;
+    
+    while (pos < buffer.size())
+    {
+        char c = buffer[pos];
         
+        if (line_start && header_end==0) header_end = pos;
+        if (line_start && c=='>') part_starts.push_back(pos);
+        line_start = false;
         
-        if (lineStream.get()!='>') throw std::logic_error("metadata not present."); //make sure metadata is present
+        if (c=='\r')
+        {
+            if (pos+1 < buffer.size() && buffer[pos+1]=='\n') pos++;
+            line_start = true;
+        }
+        else if (c=='\n')
+            line_start = true;
         
-        std::streampos  pos = 1; //allow for leading '>'
+        pos++;
+    }
+    
+    if (header_end==0 || header_end>=buffer.size()) return 0; //header only
+    
+    if (part_starts.empty() || part_starts.front()!=header_end) throw std::logic_error("metadata not present."); //make sure metadata is present
+    
+    part_starts.push_back(buffer.size());
+    
+    std::string temp_title("");
+    
+    for (size_t k = 0; k+1 < part_starts.size(); ++k)
+    {
+        scribe_part part;
+        size_t offset = part_starts[k];
+        size_t length = part_starts[k+1] - offset;
+        uint64_t hash = HashBytes(buffer.data() + offset, length);
         
-        if (type == trecento){ //read trecento header - NB not tab delimited, but standard char widths
-            
-            std::string nvox_str;
-            
-            //auditing will be required for each
-            part.rep_num =  read_part_header_field(row, pos,rep_num_length);
-            part.title = read_part_header_field(row, pos, title_length);
-            part.composer = read_part_header_field(row, pos, composer_length);
-            part.genre = read_part_header_field(row, pos, genre_length);
-            nvox_str = read_part_header_field(row, pos, voice_count_length);
-            part.num_voices = std::atoi(nvox_str.c_str());
-            part.abbrev_ms = read_part_header_field(row, pos, ms_abbrev_length);
-            part.folios = read_part_header_field(row, pos, folio_length);
-            part.voice_type = read_part_header_field(row, pos, 1).c_str()[0];
+        std::unordered_multimap<uint64_t, size_t>::iterator found = old_hashes.find(hash);
+        
+        if (found != old_hashes.end() && old_parts[found->second].byte_length == length)
+        {
+            part = old_parts[found->second];
+            part.modified = false;
+            old_hashes.erase(found); //a duplicated part must not be reused twice
         }
-        else if (type == chant) { // read in chant header, again using standard width fields, not tab delimited.
-            
-            std::string cao_str;
-            
-            part.abbrev_ms = read_part_header_field(row, pos,ms_abbrev_length);
-            part.feast  = read_part_header_field(row, pos,title_length);
-            part.office  = read_part_header_field(row, pos, office_length);
-            part.genre  = read_part_header_field(row, pos, chant_type_length); //genre holds the item data for chant type
-            part.folios  = read_part_header_field(row, pos, folio_length);
-            cao_str = read_part_header_field(row, pos, cao_num_length);
-            part.cao_num = std::atoi(cao_str.c_str());
-
+        else
+        {
+            std::stringstream in(buffer.substr(offset, length));
+            read_scribe_part<notation>(in, part);
+            part.modified = true;
         }
-        row.clear();
         
-        // read in next row and pass to parser
-        // next line will be a LINE token if staff has more or less than the default four lines
-        // otherwise is will be a clef token
-        GETLINE(file,row);
+        part.byte_offset = offset;
+        part.byte_length = length;
+        part.content_hash = hash;
+        part.partID = static_cast<int>(k) + 1;
         
-        //pre-fetch number of staff lines, so this event is not stored except in part::staff_lines
-        if (row.find("LINE")!=std::string::npos) {
-            scribe_row line = read_scribe_row(row);
-            part.initial_staff_data.staff_lines = line.events[0].pitch_num[0]; //should countain number of lines
-            GETLINE(file,row);
-        }
+        if (part.modified) changed_parts.push_back(part.partID);
         
-        //we don't want empty rows, header row, or rows that don't at least contain a suffix and prefix
-        while (!file.eof() && !row.empty() && row[0]!='>' ) {
-            scribe_row line = read_scribe_row(row);
-            //only store filled rows
-            if (line.is_comment || !line.events.empty())
-            {
-                part.rows.push_back(line);
-            }
-            row.clear();
-            GETLINE(file,row);
+        if (temp_title != part.title)
+        {
+            pieceCount++;
+            temp_title=part.title;
         }
         
-        //find first clef
-        if (!part.rows.empty())
+        parts.push_back(part);
+    }
+    
+    return static_cast<int>(parts.size());
+}
+
+//Reads the metadata row of a trecento part - NB not tab delimited, but standard char widths
+template <>
+void CScribeReaderVisitable::read_part_header<trecento>(const std::string& row, scribe_part& part)
+{
+    std::streampos  pos = 1; //allow for leading '>'
+    std::string nvox_str;
+    
+    //auditing will be required for each
+    part.rep_num =  read_part_header_field(row, pos,rep_num_length);
+    part.title = read_part_header_field(row, pos, title_length);
+    part.composer = read_part_header_field(row, pos, composer_length);
+    part.genre = read_part_header_field(row, pos, genre_length);
+    nvox_str = read_part_header_field(row, pos, voice_count_length);
+    part.num_voices = std::atoi(nvox_str.c_str());
+    part.abbrev_ms = read_part_header_field(row, pos, ms_abbrev_length);
+    part.folios = read_part_header_field(row, pos, folio_length);
+    part.voice_type = read_part_header_field(row, pos, 1).c_str()[0];
+}
+
+//Reads the metadata row of a chant part, again using standard width fields, not tab delimited.
+template <>
+void CScribeReaderVisitable::read_part_header<chant>(const std::string& row, scribe_part& part)
+{
+    std::streampos  pos = 1; //allow for leading '>'
+    std::string cao_str;
+    
+    part.abbrev_ms = read_part_header_field(row, pos,ms_abbrev_length);
+    part.feast  = read_part_header_field(row, pos,title_length);
+    part.office  = read_part_header_field(row, pos, office_length);
+    part.genre  = read_part_header_field(row, pos, chant_type_length); //genre holds the item data for chant type
+    part.folios  = read_part_header_field(row, pos, folio_length);
+    cao_str = read_part_header_field(row, pos, cao_num_length);
+    part.cao_num = std::atoi(cao_str.c_str());
+}
+
+//Reads the metadata row of a part, then each row of the part
+template <scribe_type notation>
+void CScribeReaderVisitable::read_scribe_part(std::istream& in, scribe_part& part)
+{
+    std::string row;
+    
+    //read in metadata row
+    GETLINE(in,row);
+    
+    if (row.empty() || row[0]!='>') throw std::logic_error("metadata not present."); //make sure metadata is present
+    
+    read_part_header<notation>(row, part);
+    row.clear();
+    
+    // read in next row and pass to parser
+    // next line will be a LINE token if staff has more or less than the default four lines
+    // otherwise is will be a clef token
+    GETLINE(in,row);
+    
+    //pre-fetch number of staff lines, so this event is not stored except in part::staff_lines
+    if (row.find("LINE")!=std::string::npos) {
+        scribe_row line = read_scribe_row(row);
+        part.initial_staff_data.staff_lines = line.events[0].pitch_num[0]; //should countain number of lines
+        GETLINE(in,row);
+    }
+    
+    //we don't want empty rows, header row, or rows that don't at least contain a suffix and prefix
+    while (!in.eof() && !row.empty() && row[0]!='>' ) {
+        scribe_row line = read_scribe_row(row);
+        //only store filled rows
+        if (line.is_comment || !line.events.empty())
         {
-            for (std::vector<scribe_row>::iterator r = part.rows.begin(); r!=part.rows.end(); r++) {
-                if (!r->is_comment && (r->events[0].code=="C" || r->events[0].code=="F" || r->events[0].code=="G") ) {
-                    char temp_clef = r->events[0].code[0];
-                    part.initial_staff_data.clef = temp_clef;
-                    part.initial_staff_data.clef_line = r->events[0].pitch_num[0];
-                    break;
-                }
+            part.rows.push_back(line);
+        }
+        row.clear();
+        GETLINE(in,row);
+    }
+    
+    //an empty row may only end a part; a row after it is taken for the metadata of a part, as before parts were split
+    if (row.empty())
+    {
+        while (row.empty() && !in.eof()) GETLINE(in,row);
+        if (!row.empty()) throw std::logic_error("metadata not present.");
+    }
+    
+    //find first clef
+    if (!part.rows.empty())
+    {
+        for (std::vector<scribe_row>::iterator r = part.rows.begin(); r!=part.rows.end(); r++) {
+            if (!r->is_comment && (r->events[0].code=="C" || r->events[0].code=="F" || r->events[0].code=="G") ) {
+                char temp_clef = r->events[0].code[0];
+                part.initial_staff_data.clef = temp_clef;
+                part.initial_staff_data.clef_line = r->events[0].pitch_num[0];
+                break;
             }
         }
-        
-        //Reading in a title from syllables
-        if (!part.rows.empty() && type == chant)
+    }
+    
+    resolve_pitches(part);
+    
+    //Reading in a title from syllables
+    if (notation == chant && !part.rows.empty())
+    {
+        for (std::vector<scribe_row>::iterator u = part.rows.begin(); u!=part.rows.end() &&  part.title.size()<16 ; u++)
         {
-            for (std::vector<scribe_row>::iterator u = part.rows.begin(); u!=part.rows.end() &&  part.title.size()<16 ; u++)
+            if (!u->is_comment && !u->syllable.empty() && (u->events[0].code!="C" || u->events[0].code!="F" || u->events[0].code!="G"))
             {
-                if (!u->is_comment && !u->syllable.empty() && (u->events[0].code!="C" || u->events[0].code!="F" || u->events[0].code!="G"))
+                part.title += u->syllable;
+                
+                
+                if ( part.title.back() == '-')
                 {
-                    part.title += u->syllable;
-                    
-                    
-                    if ( part.title.back() == '-')
-                    {
-                        do {
-                            part.title.pop_back();
-                            u++;
-                            part.title += u->syllable;
-                        } while (u->syllable.back() == '-');
-                        
-                    }
-                    
-                    if (part.title.back() == '.')
-                    {
+                    do {
                         part.title.pop_back();
-                        break;
-                    }
-                    part.title.push_back(' ');
+                        u++;
+                        part.title += u->syllable;
+                    } while (u->syllable.back() == '-');
                     
                 }
                 
+                if (part.title.back() == '.')
+                {
+                    part.title.pop_back();
+                    break;
+                }
+                part.title.push_back(' ');
+                
             }
             
-            if (part.title.back() == '.' || part.title.back() == '-' || std::isspace(part.title.back()) )
-            {
-                part.title.pop_back();
-            }
         }
+        
+        if (part.title.back() == '.' || part.title.back() == '-' || std::isspace(part.title.back()) )
+        {
+            part.title.pop_back();
+        }
+    }
+}
 
-        if (temp_title != part.title)
+//Resolves each number of each event of a part as a pitch under the clef in force, replaying the clef changes
+//of the part once here rather than in every consumer. A clef event sets the clef for itself and the events after it.
+//The clefs of row prefixes and suffixes are not applied: trecento files keep the default C on 7 there whatever
+//the clef events say, and chant files repeat there what the clef events have set, so the events alone decide.
+void CScribeReaderVisitable::resolve_pitches(scribe_part& part) const
+{
+    scribe_clef clef;
+    clef.clef = part.initial_staff_data.clef;
+    clef.clef_line = part.initial_staff_data.clef_line;
+    clef.staff_lines = part.initial_staff_data.staff_lines;
+    
+    size_t count = 0;
+    for (std::vector<scribe_row>::const_iterator r = part.rows.begin(); r != part.rows.end(); r++)
+        for (std::vector<scribe_event>::const_iterator e = r->events.begin(); e != r->events.end(); e++)
+            count += e->pitch_num.size();
+    
+    part.pitches.clear();
+    part.pitches.reserve(count);
+    
+    for (std::vector<scribe_row>::iterator r = part.rows.begin(); r != part.rows.end(); r++)
+    {
+        for (std::vector<scribe_event>::iterator e = r->events.begin(); e != r->events.end(); e++)
         {
-            pieceCount++;
-            temp_title=part.title;
+            e->first_pitch = part.pitches.size();
+            
+            if (e->pitch_num.empty()) continue;
+            
+            if (codes->get_code_type(e->code) == code_t::clef)
+            {
+                clef.clef = e->code[0];
+                clef.clef_line = e->pitch_num[0];
+            }
+            
+            for (std::vector<int>::const_iterator n = e->pitch_num.begin(); n != e->pitch_num.end(); n++)
+            {
+                scribe_pitch pitch = { clef.get_pitch_name(*n), clef.get_octave(*n), clef.clef, clef.clef_line };
+                part.pitches.push_back(pitch);
+            }
         }
-        numparts++;
-        part.partID = numparts;
-        
-        parts.push_back(part);
-        part.clear();
-        
     }
+}
+
+//Chooses the parser for the notation of the file once, so that no row or part is parsed with run time tests of its notation
+int CScribeReaderVisitable::load_scribe_file(const bool reuse_parts, const scribe_type notation)
+{
+    if (notation == chant) return load_scribe_file<chant>(reuse_parts);
     
-    return numparts;
+    return load_scribe_file<trecento>(reuse_parts);
 }
 
 // returns substring field and pos incremented by field length
@@ -377,6 +733,21 @@ scribe_row    CScribeReaderVisitable::read_scribe_row(std::string raw_row)
         } 
     }
     
+    //compound neumes: runs of ineumes each joined to the one before it without a gap ('@'), found in one pass
+    code_t previous_type = code_t::other;
+    for (size_t i = 0; i < s_row.events.size(); i++)
+    {
+        bool joined = !s_row.events[i].preceding_gap && i > 0;
+        code_t type = joined || (i + 1 < s_row.events.size() && !s_row.events[i + 1].preceding_gap) ? codes->get_code_type(s_row.events[i].code) : code_t::other;
+        
+        if (joined && type == code_t::ineume && previous_type == code_t::ineume)
+        {
+            if (!s_row.neume_groups.empty() && s_row.neume_groups.back().second == i) s_row.neume_groups.back().second = i + 1;
+            else s_row.neume_groups.push_back(std::make_pair(i - 1, i + 1));
+        }
+        previous_type = type;
+    }
+    
     return s_row;
 }
 
@@ -388,12 +759,12 @@ std::vector<int> CScribeReaderVisitable::get_pitch_code(char& c, std::stringstre
     std::string number_str;
     std::vector<int> pitches;
     
-    if (isnumber(c) || (c=='-' && isnumber(lineStream.peek())) || (isspace(c) && isnumber(lineStream.peek())))  //negative numbers may be used for ???; sometimes a token might have a space before the first number, though it shouldn't
+    if (isdigit(c) || (c=='-' && isdigit(lineStream.peek())) || (isspace(c) && isdigit(lineStream.peek())))  //negative numbers may be used for ???; sometimes a token might have a space before the first number, though it shouldn't
     {
         do {
             number_str.push_back(c);
             c = lineStream.get();
-        } while (isnumber(c) && !lineStream.eof());
+        } while (isdigit(c) && !lineStream.eof());
         
         if (!number_str.empty())
         {
@@ -553,10 +924,15 @@ const std::string CScribeReaderVisitable::get_ineume_part(const std::string& cod
     
 }
 
-std::string CScribeReaderVisitable::get_ligature_part(const std::string& code, const int note_count) const
+const std::string& CScribeReaderVisitable::get_ligature_part(const std::string& code, const int note_count) const
 {
-    std::string note_name = codes->code_to_name("B");
-    
+    return codes->code_to_name(get_ligature_code(code, note_count));
+}
+
+//code of the note - longa, brevis or semibrevis - at a position in a ligature
+const std::string& CScribeReaderVisitable::get_ligature_code(const std::string& code, const int note_count)
+{
+    static const std::string brevis = "B", longa = "L", semibrevis = "S";
     
     if (
         (code == "LL" || code == "VL") ||                           //with propriety and with perfection
@@ -566,15 +942,15 @@ std::string CScribeReaderVisitable::get_ligature_part(const std::string& code, c
         ( (code == "PR" || code == "PR'") && ( note_count == 0 || note_count == 2)) // ternaria without propriety and with perfection
         )
     {
-        note_name = codes->code_to_name("L");
+        return longa;
     } else if ( code == "OB'")
     {
     } else if ( code == "COB" || code == "OP" )
     {
-        note_name = codes->code_to_name("S");
+        return semibrevis;
     }
   
-    return note_name;
+    return brevis;
 }
 
 scribe_part::scribe_part()
@@ -596,8 +972,13 @@ scribe_part&   scribe_part::operator=(const scribe_part& rhs)
     office = rhs.office;
     cao_num = rhs.cao_num;
     rows = rhs.rows;
+    pitches = rhs.pitches;
     initial_staff_data = rhs.initial_staff_data;
     partID = rhs.partID;
+    byte_offset = rhs.byte_offset;
+    byte_length = rhs.byte_length;
+    content_hash = rhs.content_hash;
+    modified = rhs.modified;
     
     initial_staff_data_set = true;
     
@@ -618,9 +999,14 @@ void scribe_part::clear()
     office.clear();
     cao_num = 0;
     rows.clear();
+    pitches.clear();
     
     initial_staff_data = scribe_staff_data();
     initial_staff_data_set = false;
+    byte_offset = 0;
+    byte_length = 0;
+    content_hash = 0;
+    modified = true;
 }
 
 const char scribe_clef::get_pitch_name(const int pitch_loc)
@@ -684,8 +1070,9 @@ const int  scribe_clef::get_octave(const int pitch_loc)
             break;
     }
     
-    if ((pitch_loc-c_pos)<0) octave--;
-    octave += (pitch_loc-c_pos)/7;
+    //the octave changes at each c, below the clef's c as above it
+    int steps_from_c = pitch_loc-c_pos;
+    octave += steps_from_c>=0 ? steps_from_c/7 : -((6-steps_from_c)/7);
     
     return octave;
 }
@@ -29,6 +29,25 @@
 //  8  FEB 2014 Class created, extractor functions migrated from previous implementation of non-visitable ScribeReader class.
 //  22 FEB 2014 Changed to libMEI by Andrew Hankinson, Alastair Porter and Others
 //  23 FEB 2014 Bulk conversion of TRECENTO.NEU, SANCTORALE.NEU, TEMPORALE.NEU, and POISSY.NEU demonstrated.
+//  18 OCT 2026 SegmentScribe2MEIXML skips pieces whose parts were not modified since the last Reload.
+//  18 OCT 2026 Fingerprints of converted input kept in a manifest; unchanged pieces are not converted or written.
+//  18 OCT 2026 Committed pieces recorded in the checkpoint journal of a batch conversion.
+//  18 OCT 2026 Conversion of a shard of the pieces of a corpus, with a catalogue of the pieces converted.
+//  18 OCT 2026 Attribute values with small domains taken from pre-rendered tables.
+//  18 OCT 2026 Kind of note container tracked as a state rather than found from element names.
+//  18 OCT 2026 Invariant parts of the MEI header built once and shared by every piece.
+//  18 OCT 2026 Invariant parts of the MEI header built for each document again, as libmei keeps ids and parents by document.
+//  18 OCT 2026 Invariant parts of the MEI header rendered once as text and written in place of childless stand-ins.
+//  18 OCT 2026 Optional deterministic ids counted in document order.
+//  18 OCT 2026 MEI files stored through a CMEIWriter, so that they may be written to an archive.
+//  18 OCT 2026 MEI files renamed into place once written; the journal records them once they are stored.
+//  18 OCT 2026 Optional streaming export, writing each section as soon as it is built and then releasing it.
+//  18 OCT 2026 All MEI text written by CMEISerializer, with vectorised escaping, rather than XmlExport.
+//  18 OCT 2026 Visits Scribe data through the compile-time visitors of CVisitor.h rather than Loki's.
+//  18 OCT 2026 Staves and notes made by templates instantiated for chant and trecento notation.
+//  18 OCT 2026 Staves built by hooks called from a CScribeTraversal, so that other consumers share its pass.
+//  18 OCT 2026 Compound neumes grouped by the reader, in place of the disabled IGNOREGAPS branch.
+//  18 OCT 2026 Pitches read from the pitches the reader resolved for each part, rather than by replaying clef changes.
 //
 //  To do:
 //          - restore print function
@@ -42,7 +61,6 @@
 
 #include "CScribeToNeoScribeXML.h"
 
-#include <mei/xmlexport.h>
 #include <mei/neumes.h>
 #include <mei/mensural.h>
 #include <mei/namesdates.h>
@@ -51,25 +69,99 @@
 
 
 #include "CScribeReaderVisitable.h"
+#include "CScribeTraversal.h"
 #include "CScribeCodes.h"
+#include "CAttributeValues.h"
+#include "CMEISerializer.h"
 #include "Header.h"
 
-#define IGNOREGAPS true
-
 using namespace mei;
 
 
 CScribeToNeoScribeXML::CScribeToNeoScribeXML(const std::string& encoder_name)
 {
     sourcekey = new CSourceKey(PROCWORKINGDIRECTORY + SOURCE_KEY_CSV);
+    manifest = new CManifest(MANIFEST_FILE);
+    writer = new CAtomicWriter(1);
+    writer->on_stored([this] (const std::string& file_name) { Stored(file_name); });
     encoder = encoder_name;
     doc = new MeiDocument();
+    InitConversionSeed();
+}
+
+//converters running in several threads share one manifest, which remains owned by the caller
+CScribeToNeoScribeXML::CScribeToNeoScribeXML(const std::string& encoder_name, CManifest* shared_manifest)
+{
+    sourcekey = new CSourceKey(PROCWORKINGDIRECTORY + SOURCE_KEY_CSV);
+    manifest = shared_manifest;
+    owns_manifest = false;
+    writer = new CAtomicWriter(1);
+    writer->on_stored([this] (const std::string& file_name) { Stored(file_name); });
+    encoder = encoder_name;
+    doc = new MeiDocument();
+    InitConversionSeed();
 }
 
 CScribeToNeoScribeXML::~CScribeToNeoScribeXML()
 {
     delete sourcekey;
+    if (owns_manifest) delete manifest;
+    if (owns_writer) delete writer;
+    delete stream;
+    delete doc;
+}
+
+void CScribeToNeoScribeXML::NewMEIDocument()
+{
+    header_stand_ins.clear();
     delete doc;
+    doc = new MeiDocument();
+}
+
+//fingerprint everything other than the Scribe data upon which a conversion depends
+void CScribeToNeoScribeXML::InitConversionSeed()
+{
+    conversion_seed = HashFile(PROCWORKINGDIRECTORY + TRECENTO_CODES_CSV);
+    conversion_seed = HashFile(PROCWORKINGDIRECTORY + CHANT_CODES_CSV, conversion_seed);
+    conversion_seed = HashFile(PROCWORKINGDIRECTORY + SOURCE_KEY_CSV, conversion_seed);
+    conversion_seed = HashBytes(CONVERTER_VERSION.data(), CONVERTER_VERSION.size(), conversion_seed);
+    conversion_seed = HashBytes(encoder.data(), encoder.size(), conversion_seed);
+    
+    if (deterministic_ids) conversion_seed = HashBytes("ids", 3, conversion_seed);
+    if (compact) conversion_seed = HashBytes("compact", 7, conversion_seed);
+}
+
+//MEI files are written as loose files unless another writer is given, which remains owned by the caller
+void CScribeToNeoScribeXML::SetWriter(CMEIWriter* output_writer)
+{
+    if (owns_writer) delete writer;
+    writer = output_writer;
+    owns_writer = false;
+    writer->on_stored([this] (const std::string& file_name) { Stored(file_name); });
+}
+
+//outputs written with generated ids are not current when deterministic ids are wanted, and vice versa
+void CScribeToNeoScribeXML::SetDeterministicIds(const bool counter_ids)
+{
+    deterministic_ids = counter_ids;
+    InitConversionSeed();
+}
+
+//outputs written in one profile are not current when the other is wanted
+void CScribeToNeoScribeXML::SetCompact(const bool compact_profile)
+{
+    compact = compact_profile;
+    InitConversionSeed();
+}
+
+//index counts from 0; MEI files and the manifest of the shard are kept in directory
+void CScribeToNeoScribeXML::SetShard(const int index, const int count, const std::string& directory)
+{
+    if (count < 1 || index < 0 || index >= count) throw std::logic_error("Bad shard " + std::to_string(index) + " of " + std::to_string(count));
+    
+    shard_index = index;
+    shard_count = count;
+    output_directory = directory;
 }
 
 void CScribeToNeoScribeXML::Visit(CScribeReaderVisitable& scribe_data)
@@ -103,38 +195,217 @@ void CScribeToNeoScribeXML::PrintMEIXML(const std::string& encoder_name)
 
 void CScribeToNeoScribeXML::SaveMEIXML(const std::string& file_name, const std::string& encoder_name)
 {
-    std::cout << "Saving converted file " << file_name << std::endl;
-    XmlExport::meiDocumentToFile(doc, file_name);
+    WriteMEIXML(file_name);
     
+    if (!current_source.empty())
+        Commit(current_source, SourceFingerprint(current_source_hash));
 }
+
 //===================================================================================================
 //
-//  Function:   Scribe2MEIXML
-//  Purpose:    Builds MEI XML representation of a Scribe file converted to MEI-compliant format with extensions.
-//              Produces a single file reflecting the content of the file input into CScribeReader. Works
-//              best for Scribe files containing one part, but will convert composite Scribe data
-//  Used by:    SaveMEIXML
-//  Inputs:     encoder_name, string naming original Scribe encoder
+//  Function:   ConvertScribeFile
+//  Purpose:    Converts a Scribe file to a single MEI file named after it if it contains one piece,
+//              otherwise to one MEI file per piece. After a Reload only modified pieces are converted.
+//              The file is converted in a single CScribeTraversal, whose BeginFile plans its pieces.
+//  Output:     number of pieces in the Scribe file
+//  Used by:    none - public function call
 //
 //===================================================================================================
 
-MeiDocument* CScribeToNeoScribeXML::Scribe2MEIXML(const CScribeReaderVisitable& scribe_data)
+int CScribeToNeoScribeXML::ConvertScribeFile(CScribeReaderVisitable& scribe_data)
+{
+    CScribeTraversal<CScribeToNeoScribeXML> pass(*this);
+    scribe_data.Accept(pass);
+    
+    return scribe_data.PieceCount();
+}
+
+//===================================================================================================
+//
+//  Functions:  BeginFile, EndFile
+//  Purpose:    BeginFile plans the pieces of a Scribe file to be converted as it is traversed, and EndFile
+//              commits the Scribe file once they are written. A file of one piece is converted to a single
+//              MEI file named after it, a file of several to one MEI file per piece (see PlanSegments).
+//  Used by:    CScribeTraversal, ConvertScribeFile
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::BeginFile(const CScribeReaderVisitable& scribe_data)
+{
+    current_data = &scribe_data;
+    current_source = scribe_data.GetFileName();
+    current_source_hash = scribe_data.GetContentHash();
+    pieces.clear();
+    next_piece = 0;
+    commit_source = false;
+    
+    if (scribe_data.PieceCount()==1)
+    {
+        const std::vector<scribe_part>& parts = scribe_data.GetScribeParts();
+        std::string xml_file_name = UncompressedName(scribe_data.GetFileName()) + ".xml";
+        uint64_t fingerprint = PieceFingerprint(parts.begin(), parts.end());
+        
+        commit_source = true;
+        if (!InShard(xml_file_name)) return;
+        
+        if (catalogue) catalogue->add(BaseName(xml_file_name), current_source, parts.front());
+        
+        xml_file_name = writer->location(OutputPath(xml_file_name));
+        
+        //the output may already have been committed by an interrupted batch, or, after a Reload, written unchanged
+        if (OutputIsCurrent(xml_file_name, fingerprint, scribe_data.ChangedParts().empty())) return;
+        
+        pieces.push_back(piece_plan { parts.begin(), parts.end(), 1, false, xml_file_name, fingerprint });
+    }
+    else if (scribe_data.PieceCount()>1)
+        PlanSegments(scribe_data);
+}
+
+void CScribeToNeoScribeXML::EndFile(const CScribeReaderVisitable&)
 {
+    if (commit_source) Commit(current_source, SourceFingerprint(current_source_hash));
+    current_data = NULL;
+}
+
+//===================================================================================================
+//
+//  Function:   PlanSegments
+//  Purpose:    Plans one MEI file for each piece of a Scribe file - trecento pieces collect all parts with
+//              the same REPNUM, chant pieces are single parts. Pieces outside the shard are passed over,
+//              and pieces whose input is unchanged since the last conversion are committed but not planned.
+//  Used by:    BeginFile, SegmentScribe2MEIXML
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::PlanSegments(const CScribeReaderVisitable& scribe_data)
+{
+    std::unordered_set<std::string> rep_no_record;
+    
+    //all pieces written, or found current, make the Scribe file itself current
+    commit_source = true;
+    
+    for (std::vector<scribe_part>::const_iterator part = scribe_data.GetScribeParts().begin(); part != scribe_data.GetScribeParts().end(); part++)
+    {
+        //record of first part
+        const scribe_part& first_part = *part;
+        
+        //find end of piece - trecento pieces collect all parts with the same REPNUM, chant pieces are single parts
+        std::vector<scribe_part>::const_iterator piece_end = part + 1;
+        if (scribe_data.GetType()==scribe_type::trecento)
+        {
+            while (piece_end != scribe_data.GetScribeParts().end() && piece_end->rep_num==first_part.rep_num) piece_end++;
+        }
+        
+        std::string xml_file_name("");
+        
+        if (scribe_data.GetType()==scribe_type::trecento)
+        {
+            xml_file_name = first_part.rep_num;
+            
+            //find duplicates - doesn't find triplicates
+            if (rep_no_record.find(first_part.rep_num) == rep_no_record.end())
+            {
+                rep_no_record.insert(first_part.rep_num);
+            }
+            else
+            {
+                xml_file_name += " copy";
+            }
+        }
+        else if (scribe_data.GetType()==scribe_type::chant)
+        {
+            xml_file_name = part->abbrev_ms + ZeroPadNumber(part->partID,4)+ " (" + std::to_string(first_part.cao_num) + ")";
+        }
+        
+        //need to check if there already exists a file with the same name
+        
+        xml_file_name +=  ".xml";
+        
+        //a sharded conversion converts only its own pieces, and writes them into its own directory
+        if (!InShard(xml_file_name))
+        {
+            part = piece_end - 1;
+            continue;
+        }
+        
+        if (catalogue) catalogue->add(xml_file_name, current_source, first_part);
+        
+        xml_file_name = writer->location(OutputPath(xml_file_name));
+        
+        //after a Reload, pieces none of whose parts were reparsed were written earlier in the run
+        bool piece_modified = false;
+        for (std::vector<scribe_part>::const_iterator p = part; p != piece_end; p++)
+            piece_modified = piece_modified || p->modified;
+        
+        //pieces whose input is unchanged since the last conversion are neither converted nor written, as long as
+        //their output is still there under the same name; a part inserted or removed renames the pieces after it
+        uint64_t fingerprint = PieceFingerprint(part, piece_end);
+        
+        if (OutputIsCurrent(xml_file_name, fingerprint, !piece_modified))
+            Commit(xml_file_name, fingerprint, current_source);
+        else
+            pieces.push_back(piece_plan { part, piece_end, scribe_data.GetType()==scribe_type::chant ? 0 : 1, true, xml_file_name, fingerprint });
+        
+        part = piece_end - 1; // step to last part in piece
+    }
+}
+
+//===================================================================================================
+//
+//  Functions:  BeginPiece, EndPiece
+//  Purpose:    BeginPiece makes a new MEI document for a planned piece, with its header and the score to
+//              which the sections of its parts are added; when streaming, it is written up to the first
+//              section. EndPiece writes the document, unless the piece is to be saved by the caller.
+//  Used by:    BeginPart, EndPart, Scribe2MEIXML
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::BeginPiece(const piece_plan& piece)
+{
+    //create an instance of XML doc representation, etc.
+    NewMEIDocument();
     
     Mei* mei = new Mei;
     doc->setRootElement(mei);
-
+    /*
+        MEI
+            - <meiHead>
+                - FileDescription
+                - EncodingDescription
+                - Work Description
+                - Revision Description
+     
+     */
+    RenderHeaderTemplates();
+    
     //create MEIhead to contain file, encoding, work and revision description
     MeiHead* mei_head = new MeiHead; //"meiHead"
     mei->addChild(mei_head);
     
+    if (piece.segmented)
+    {
+        AltId* altId = new AltId;
+        mei_head->addChild(altId);
+        if (current_data->GetType()==scribe_type::trecento)
+        {
+            altId->addAttribute("type", "repnum");
+            altId->setValue(piece.first->rep_num);
+        } else if (current_data->GetType()==scribe_type::trecento)
+        {
+            altId->addAttribute("type", "cao");
+            altId->setValue(std::to_string(piece.first->cao_num));
+            
+        }
+    }
+    
     //Create and link fileDesc
     FileDesc* fileDesc = Scribe2MEIFileDesc();
     mei_head->addChild(fileDesc);
     
-    //Create and link encodingDesc
-    EncodingDesc* encodingDesc = Scribe2MEIEncoderDesc();
+    //Create and link encodingDesc, the same for every piece
+    EncodingDesc* encodingDesc = new EncodingDesc;
     mei_head->addChild(encodingDesc);
+    StandIn(encodingDesc, encodingdesc_template);
     
     //Create and link workDesc
     WorkDesc* workDesc = Scribe2MEIWorkDesc();
@@ -146,37 +417,375 @@ MeiDocument* CScribeToNeoScribeXML::Scribe2MEIXML(const CScribeReaderVisitable&
     mei->addChild(music);
     Mdiv* mdiv = new Mdiv; //for chant source this needs to be specified repeatedly, with n and type attributes
     music->addChild(mdiv);
-    Score* score = new Score;
-    mdiv->addChild(score);
+    piece_score = new Score;
+    mdiv->addChild(piece_score);
     
     //start adding score definitions - child of score
     ScoreDef* scoredef = new ScoreDef;
-    score->addChild(scoredef);
-    StaffGrp* staffgrp = new StaffGrp;
-    scoredef->addChild(staffgrp);
-    staffgrp->setId("all");
+    piece_score->addChild(scoredef);
+    piece_staffgrp = new StaffGrp;
+    scoredef->addChild(piece_staffgrp);
+    piece_staffgrp->setId("all");
+    
+    if (piece.first != piece.last)
+    {
+        Scribe2MEIXMLFileData(fileDesc, *piece.first);
+        Scribe2MEIXMLWorkData(workDesc, *piece.first);
+    }
+    
+    doc_fingerprint = piece.fingerprint;
+    staff_number = piece.first_number;
+    
+    if (streaming) BeginStream(piece.first, piece.last, piece.first_number, piece_score, piece_staffgrp, piece.file_name);
+}
+
+void CScribeToNeoScribeXML::EndPiece(const piece_plan& piece)
+{
+    if (stream) EndStream();
+    
+    if (!piece.file_name.empty()) WriteMEIXML(piece.file_name);
+    
+    piece_score = NULL;
+    piece_staffgrp = NULL;
+}
+
+//===================================================================================================
+//
+//  Function:   InShard
+//  Purpose:    Tests whether a piece belongs to the shard being converted. Pieces are assigned by a hash
+//              of the names of their Scribe file and MEI file, excluding directories, so that every process
+//              or machine converting a shard of the same corpus makes the same assignment.
+//  Input:      name of MEI file of the piece
+//  Used by:    ConvertScribeFile, SegmentScribe2MEIXML
+//
+//===================================================================================================
+
+const bool CScribeToNeoScribeXML::InShard(const std::string& xml_file_name) const
+{
+    if (shard_count <= 1) return true;
     
-    int i=0;
+    std::string piece = BaseName(current_source) + '\t' + BaseName(xml_file_name);
     
-    for (std::vector<scribe_part>::const_iterator partit = scribe_data.GetScribeParts().begin(); partit!=scribe_data.GetScribeParts().end(); partit++)
+    return HashBytes(piece.data(), piece.size()) % shard_count == static_cast<uint64_t>(shard_index);
+}
+
+//a sharded conversion writes its MEI files into the shard directory
+std::string CScribeToNeoScribeXML::OutputPath(const std::string& xml_file_name) const
+{
+    if (output_directory.empty()) return xml_file_name;
+    
+    return output_directory + "/" + BaseName(xml_file_name);
+}
+
+//writes the current MEIdoc and records the fingerprint of its input in the manifest
+void CScribeToNeoScribeXML::WriteMEIXML(const std::string& file_name)
+{
+    std::cout << "Saving converted file " << file_name << std::endl;
+    
+    std::string text;
+    
+    //a streamed piece has already been written, to the writer or to stream_text, and its ids assigned
+    if (stream)
+    {
+        delete stream;
+        stream = NULL;
+        
+        if (!stream_location.empty())
+        {
+            stream_location.clear();
+            AwaitStorage(file_name, doc_fingerprint, current_source);
+            writer->end();
+            return;
+        }
+        text.swap(stream_text);
+    }
+    else
     {
-        ++i;
-        if (i==1)
+        if (deterministic_ids)
         {
-            Scribe2MEIXMLFileData(fileDesc, *partit);
-            Scribe2MEIXMLWorkData(workDesc, *partit);
+            int count = 0, staff_count = 0;
+            AssignIds(doc->getRootElement(), count, staff_count);
         }
+        CMEISerializer serializer(text, !compact);
+        SpliceHeader(serializer);
+        serializer.declaration();
+        serializer.write(doc->getRootElement());
+    }
+    
+    //the writer may report the file stored before write returns; it is committed by Stored
+    AwaitStorage(file_name, doc_fingerprint, current_source);
+    writer->write(file_name, text);
+}
+
+//records an MEI file already current or a completely converted Scribe file in the manifest, and a Scribe
+//file in the journal of a batch, once all of its MEI files are stored; written MEI files are committed by Stored
+void CScribeToNeoScribeXML::Commit(const std::string& key, const uint64_t fingerprint, const std::string& owner)
+{
+    std::lock_guard<std::mutex> guard(storage_lock);
+    
+    if (owner.empty() && unstored_count.count(key))
+    {
+        waiting_sources[key] = fingerprint;
+        return;
+    }
+    
+    manifest->update(key, fingerprint, owner);
+    if (journal && owner.empty()) journal->record(key, fingerprint, owner);
+}
+
+void CScribeToNeoScribeXML::AwaitStorage(const std::string& file_name, const uint64_t fingerprint, const std::string& owner)
+{
+    std::lock_guard<std::mutex> guard(storage_lock);
+    
+    unstored[file_name].push_back(std::make_pair(fingerprint, owner));
+    unstored_count[owner]++;
+}
+
+//called by the writer once an MEI file is completely stored at its location; a file whose writing or
+//compression fails is never reported, so it is not in the manifest and is converted again
+void CScribeToNeoScribeXML::Stored(const std::string& file_name)
+{
+    std::lock_guard<std::mutex> guard(storage_lock);
+    
+    std::map<std::string, std::deque<std::pair<uint64_t, std::string> > >::iterator found = unstored.find(file_name);
+    if (found == unstored.end()) return;
+    
+    //writes of the same location are stored in the order they were made
+    std::pair<uint64_t, std::string> written = found->second.front();
+    found->second.pop_front();
+    if (found->second.empty()) unstored.erase(found);
+    
+    manifest->update(file_name, written.first, written.second);
+    if (journal) journal->record(file_name, written.first, written.second);
+    
+    if (--unstored_count[written.second] > 0) return;
+    unstored_count.erase(written.second);
+    
+    std::map<std::string, uint64_t>::iterator source = waiting_sources.find(written.second);
+    if (source != waiting_sources.end())
+    {
+        manifest->update(source->first, source->second, "");
+        if (journal) journal->record(source->first, source->second, "");
+        waiting_sources.erase(source);
+    }
+}
+
+//===================================================================================================
+//
+//  Function:   AssignIds
+//  Purpose:    Replaces the ids generated by libmei with ids counted in document order, so that the same
+//              input always produces the same output. Elements within the nth staff are numbered "sNeM",
+//              other elements "eM". Ids set by the exporter itself, such as that of the staff group, are kept.
+//  Input:      root of the elements to number, and the counts of elements and staves numbered before it,
+//              so that a document written in parts is numbered as it would be whole
+//  Used by:    WriteMEIXML, BeginStream, EndPart
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::AssignIds(MeiElement* root, int& count, int& staff_count)
+{
+    //elements waiting to be numbered, each with the number of the staff containing it (0 if none)
+    std::vector<std::pair<MeiElement*, int> > pending(1, std::make_pair(root, 0));
+    int staff_element_count = 0;
+    
+    //depth first, in document order
+    while (!pending.empty())
+    {
+        MeiElement* element = pending.back().first;
+        int staff = pending.back().second;
+        pending.pop_back();
         
-        //add section - child of score
-        Section* section = new Section();
-        score->addChild(section);
+        //the elements of a part of the header rendered once are numbered as they are written in its place
+        if (header_stand_in* standing = FindStandIn(element))
+        {
+            standing->ids.clear();
+            for (size_t i = 0; i < standing->part->numbered.size(); i++)
+                standing->ids.push_back(standing->part->numbered[i] ? "e" + std::to_string(++count) : standing->part->rendered.ids[i]);
+            continue;
+        }
+        
+        if (dynamic_cast<Staff*>(element))
+        {
+            staff = ++staff_count;
+            staff_element_count = 0;
+        }
         
-        //handle staff and link to section
-        Staff* staff = Scribe2MEIXMLStaff(scribe_data, *partit, staffgrp, i);
-        section->addChild(staff);
+        if (!KeepsId(element))
+        {
+            if (staff) element->setId("s" + std::to_string(staff) + "e" + std::to_string(++staff_element_count));
+            else element->setId("e" + std::to_string(++count));
+        }
         
+        const std::vector<MeiElement*>& children = element->getChildren();
+        for (std::vector<MeiElement*>::const_reverse_iterator child = children.rbegin(); child != children.rend(); child++)
+            pending.push_back(std::make_pair(*child, staff));
+    }
+}
+
+//===================================================================================================
+//
+//  Function:   BeginStream
+//  Purpose:    Starts writing a piece in streaming mode, in which each section is written to stream_text
+//              as soon as it is built and then deleted, and stream_text is handed to the writer, so that
+//              no more than one section of a piece is held in memory, as text or as elements. The staff
+//              definitions of all parts are made first, so that everything up to the first section can be
+//              written at once. A piece saved by the caller rather than written to file_name is kept in
+//              stream_text until it is saved.
+//  Input:      parts of the piece, number of the first, the score and staff group of the document, and
+//              the MEI file of the piece, if it is written when it ends
+//  Used by:    BeginPiece
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::BeginStream(std::vector<scribe_part>::const_iterator first, std::vector<scribe_part>::const_iterator last, const int first_number, Score* score, StaffGrp* staffgrp, const std::string& file_name)
+{
+    int i = first_number;
+    for (std::vector<scribe_part>::const_iterator part = first; part != last; part++, i++)
+        staffgrp->addChild(Scribe2MEIXMLStaffDef(*part, i));
+    
+    stream_count = stream_staff_count = 0;
+    if (deterministic_ids) AssignIds(doc->getRootElement(), stream_count, stream_staff_count);
+    
+    stream_text.clear();
+    delete stream;
+    stream = new CMEISerializer(stream_text, !compact);
+    SpliceHeader(*stream);
+    stream->declaration();
+    
+    //open each ancestor of the score, writing whole whatever precedes the next
+    std::vector<MeiElement*> ancestors;
+    for (MeiElement* element = score; element; element = element->hasParent() ? element->getParent() : NULL)
+        ancestors.push_back(element);
+    
+    for (std::vector<MeiElement*>::reverse_iterator ancestor = ancestors.rbegin(); ancestor != ancestors.rend(); ancestor++)
+    {
+        stream->open(*ancestor);
+        
+        const std::vector<MeiElement*>& children = (*ancestor)->getChildren();
+        for (std::vector<MeiElement*>::const_iterator child = children.begin(); child != children.end(); child++)
+        {
+            if (ancestor + 1 != ancestors.rend() && *child == *(ancestor + 1)) break;
+            stream->write(*child);
+        }
+    }
+    
+    stream_score = score;
+    
+    stream_location = file_name;
+    if (!stream_location.empty()) writer->begin(stream_location);
+    FlushStream();
+}
+
+//hands what has been written of the piece to the writer
+void CScribeToNeoScribeXML::FlushStream()
+{
+    if (stream_location.empty()) return;
+    
+    writer->append(stream_text);
+    stream_text.clear();
+}
+
+//closes the elements left open by BeginStream
+void CScribeToNeoScribeXML::EndStream()
+{
+    for (MeiElement* element = stream_score; element; element = element->hasParent() ? element->getParent() : NULL)
+        stream->close(element);
+    
+    FlushStream();
+}
+
+//===================================================================================================
+//
+//  Function:   IsCurrent
+//  Purpose:    Tests whether a Scribe file needs converting at all. A file is current if the manifest
+//              records the same fingerprint for it and all MEI files written from it still exist.
+//  Input:      name of Scribe file, and optionally the hash of its contents if it has already been read
+//  Used by:    none - public function call
+//
+//===================================================================================================
+
+const bool CScribeToNeoScribeXML::IsCurrent(const std::string& scribe_file)
+{
+    return IsCurrent(scribe_file, HashFile(scribe_file));
+}
+
+const bool CScribeToNeoScribeXML::IsCurrent(const std::string& scribe_file, const uint64_t content_hash)
+{
+    //a forced batch that is resumed does not convert again what it committed before the interruption
+    if (force && !(journal && journal->committed(scribe_file))) return false;
+    
+    if (!manifest->is_current(scribe_file, SourceFingerprint(content_hash))) return false;
+    
+    std::vector<std::string> outputs = manifest->owned_by(scribe_file);
+    
+    if (outputs.empty()) return false;
+    
+    for (std::vector<std::string>::const_iterator o = outputs.begin(); o != outputs.end(); o++)
+    {
+        if (!writer->exists(*o)) return false;
+    }
+    
+    return true;
+}
+
+//fingerprint of a whole Scribe file from the hash of its contents
+uint64_t CScribeToNeoScribeXML::SourceFingerprint(const uint64_t content_hash) const
+{
+    return HashBytes(reinterpret_cast<const char*>(&content_hash), sizeof(content_hash), conversion_seed);
+}
+
+//fingerprint of a piece from the hashes of its parts
+uint64_t CScribeToNeoScribeXML::PieceFingerprint(std::vector<scribe_part>::const_iterator first, std::vector<scribe_part>::const_iterator last) const
+{
+    uint64_t fingerprint = conversion_seed;
+    
+    for ( ; first != last; first++)
+    {
+        fingerprint = HashBytes(reinterpret_cast<const char*>(&first->content_hash), sizeof(first->content_hash), fingerprint);
+    }
+    
+    return fingerprint;
+}
+
+//an output need not be written again if it exists and was written from the same input; -force converts each
+//output once in a run, so it does not apply to outputs written earlier in the run and unchanged since
+const bool CScribeToNeoScribeXML::OutputIsCurrent(const std::string& file_name, const uint64_t fingerprint, const bool written_in_run) const
+{
+    if (force && !written_in_run && !(journal && journal->committed(file_name))) return false;
+    if (!manifest->is_current(file_name, fingerprint)) return false;
+    
+    return writer->exists(file_name);
+}
+//===================================================================================================
+//
+//  Function:   Scribe2MEIXML
+//  Purpose:    Builds MEI XML representation of a Scribe file converted to MEI-compliant format with extensions,
+//              treating the whole file as one piece, to be saved by SaveMEIXML
+//  Used by:    Visit
+//
+//===================================================================================================
+
+MeiDocument* CScribeToNeoScribeXML::Scribe2MEIXML(const CScribeReaderVisitable& scribe_data)
+{
+    const std::vector<scribe_part>& parts = scribe_data.GetScribeParts();
+    
+    current_data = &scribe_data;
+    current_source = scribe_data.GetFileName();
+    current_source_hash = scribe_data.GetContentHash();
+    pieces.assign(1, piece_plan { parts.begin(), parts.end(), 1, false, "", PieceFingerprint(parts.begin(), parts.end()) });
+    next_piece = 0;
+    
+    //a file without parts is still given a document
+    if (parts.empty())
+    {
+        BeginPiece(pieces.front());
+        EndPiece(pieces[next_piece++]);
     }
     
+    CScribeTraversal<CScribeToNeoScribeXML> pass(*this);
+    pass.walk(scribe_data);
+    
+    current_data = NULL;
     return doc;
 }
 
@@ -193,142 +802,18 @@ MeiDocument* CScribeToNeoScribeXML::Scribe2MEIXML(const CScribeReaderVisitable&
 
 void CScribeToNeoScribeXML::SegmentScribe2MEIXML(const CScribeReaderVisitable& scribe_data)
 {
-    std::unordered_set<std::string> rep_no_record;
+    current_data = &scribe_data;
+    current_source = scribe_data.GetFileName();
+    current_source_hash = scribe_data.GetContentHash();
+    pieces.clear();
+    next_piece = 0;
     
-    for (std::vector<scribe_part>::const_iterator part = scribe_data.GetScribeParts().begin(); part != scribe_data.GetScribeParts().end(); part++)
-    {
-        int i = 0;
-        
-        //save record of first part
-        scribe_part first_part = *part;
-        
-        //create an instance of XML doc representation, etc.
-        delete doc;
-        doc = new MeiDocument();
-        
-        Mei *mei = new Mei;
-        doc->setRootElement(mei);
-        /*
-            MEI
-                - <meiHead>
-                    - FileDescription
-                    - EncodingDescription
-                    - Work Description
-                    - Revision Description
-         
-         */
-        //create MEIhead to contain file, encoding, work and revision description
-        MeiHead* mei_head = new MeiHead;
-        mei->addChild(mei_head);
-        
-        AltId* altId = new AltId;
-        mei_head->addChild(altId);
-        if (scribe_data.GetType()==scribe_type::trecento)
-        {
-            altId->addAttribute("type", "repnum");
-            altId->setValue(part->rep_num);
-        } else if (scribe_data.GetType()==scribe_type::trecento)
-        {
-            altId->addAttribute("type", "cao");
-            altId->setValue(std::to_string(part->cao_num));
-
-        }
-        //Create and link fileDesc
-        FileDesc* fileDesc = Scribe2MEIFileDesc();
-        mei_head->addChild(fileDesc);
-        
-        //Create and link encodingDesc
-        EncodingDesc* encodingDesc = Scribe2MEIEncoderDesc();
-        mei_head->addChild(encodingDesc);
-        
-        //Create and link workDesc
-        WorkDesc* workDesc = Scribe2MEIWorkDesc();
-        mei_head->addChild(workDesc);
-        //</meiHead> - not really at this stage - other elements completed in main routine
-        
-        //music - contains all music data
-        Music* music = new Music;
-        mei->addChild(music);
-        Mdiv* mdiv = new Mdiv; //for chant source this needs to be specified repeatedly, with n and type attributes
-        music->addChild(mdiv);
-        Score* score = new Score;
-        mdiv->addChild(score);
-        
-        //start adding score definitions - child of score
-        ScoreDef* scoredef = new ScoreDef;
-        score->addChild(scoredef);
-        StaffGrp* staffgrp = new StaffGrp;
-        scoredef->addChild(staffgrp);
-        staffgrp->setId("all");
-        
-        //skip along and collect parts - all have the same REPNUM
-        
-        std::string xml_file_name("");
-        
-        if (scribe_data.GetType()==scribe_type::trecento)
-        {
-            do
-            {
-                ++i;
-                
-                if (i==1)
-                {
-                    Scribe2MEIXMLFileData(fileDesc, *part);
-                    Scribe2MEIXMLWorkData(workDesc, *part);
-                }
-                //add section - child of score
-                Section* section = new Section;
-                score->addChild(section);
-                
-                //handle staff and link to section
-                Staff* staff = Scribe2MEIXMLStaff(scribe_data, *part, staffgrp, i);
-                section->addChild(staff); //or TiXmlElement* layer;?
-                
-                part++;
-                
-            } while ( part->rep_num==first_part.rep_num && part != scribe_data.GetScribeParts().end());
-            
-            part--; // step back to last part in piece
-            
-            xml_file_name = first_part.rep_num;
-            
-            //find duplicates - doesn't find triplicates
-            if (rep_no_record.find(part->rep_num) == rep_no_record.end())
-            {
-                rep_no_record.insert(part->rep_num);
-            }
-            else
-            {
-                xml_file_name += " copy";
-            }
-            
-        }
-        else if (scribe_data.GetType()==scribe_type::chant)
-        {
-            
-            Scribe2MEIXMLFileData(fileDesc, *part);
-            Scribe2MEIXMLWorkData(workDesc, *part);
-            
-                //add section - child of score
-            Section* section = new Section;
-            score->addChild(section);
-                
-                //handle staff and link to section
-            Staff* staff = Scribe2MEIXMLStaff(scribe_data, *part, staffgrp, i);
-            section->addChild(staff);
-            
-            xml_file_name = part->abbrev_ms + ZeroPadNumber(part->partID,4)+ " (" + std::to_string(first_part.cao_num) + ")";
-            
-        }
-        
-        //need to check if there already exists a file with the same name
-        
-        xml_file_name +=  ".xml";
-        
-        SaveMEIXML(xml_file_name);
+    PlanSegments(scribe_data);
     
-    }
+    CScribeTraversal<CScribeToNeoScribeXML> pass(*this);
+    pass.walk(scribe_data);
     
+    EndFile(scribe_data);
 }
 
 //===================================================================================================
@@ -353,10 +838,30 @@ FileDesc* CScribeToNeoScribeXML::Scribe2MEIFileDesc()
     //mei_head - <fileDesc>
     FileDesc* fileDesc = new FileDesc;
     
-    //fileDesc - <pubStmt>
-    
+    //fileDesc - <pubStmt>, the same for every piece
     PubStmt* pubStmt = new PubStmt;
     fileDesc->addChild(pubStmt);
+    StandIn(pubStmt, pubstmt_template);
+    
+    //fileDesc - <seriesStmt>
+    SeriesStmt* seriesStmt = new SeriesStmt();
+    fileDesc->addChild(seriesStmt);
+    
+    return fileDesc;
+    
+}
+
+//===================================================================================================
+//
+//  Function:   Scribe2MEIPubStmt
+//  Purpose:    utility function to create the publication statement of the file description, which is the
+//              same for every piece, and so is rendered once and written in place of a stand-in
+//  Used by:    RenderHeaderTemplates
+//
+//===================================================================================================
+PubStmt* CScribeToNeoScribeXML::Scribe2MEIPubStmt()
+{
+    PubStmt* pubStmt = new PubStmt;
     RespStmt* pubRespStmt = new RespStmt;
     pubRespStmt->setValue("http://www.lib.latrobe.edu.au/MMDB/");
     pubStmt->addChild(pubRespStmt);
@@ -376,20 +881,15 @@ FileDesc* CScribeToNeoScribeXML::Scribe2MEIFileDesc()
     avail->addChild(CRS);
     pubStmt->addChild(avail);
     
-    //fileDesc - <seriesStmt>
-    SeriesStmt* seriesStmt = new SeriesStmt();
-    fileDesc->addChild(seriesStmt);
-    
-    return fileDesc;
-    
+    return pubStmt;
 }
 
 //===================================================================================================
 //
 //  Function:   Scribe2MEIEncoderDesc
 //  Purpose:    utility function to create basic Encoder Description for MEI header structure filed with
-//              NeoScribe data
-//  Used by: 
+//              NeoScribe data, which is the same for every piece, and so is rendered once
+//  Used by:    RenderHeaderTemplates
 //
 //===================================================================================================
 EncodingDesc* CScribeToNeoScribeXML::Scribe2MEIEncoderDesc()
@@ -407,12 +907,84 @@ EncodingDesc* CScribeToNeoScribeXML::Scribe2MEIEncoderDesc()
     Application* application = new Application;
     appInfo->addChild(application);
     application->setId("xsl_scribe2neoscribexml");
-    application->setVersion("0.1");
+    application->setVersion(CONVERTER_VERSION);
     application->setValue("Scribe2NeoScribeXML");
     
     return encodingDesc;
 }
 
+//===================================================================================================
+//
+//  Function:   RenderHeaderTemplates
+//  Purpose:    Renders the parts of the MEI header that are the same for every piece, the publication
+//              statement and the encoding description, once for the profile being written, so that each
+//              document need only hold a childless stand-in for each (see StandIn)
+//  Used by:    BeginPiece
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::RenderHeaderTemplates()
+{
+    bool pretty = !compact;
+    
+    if (!pubstmt_template.rendered.text.empty() && pubstmt_template.rendered.pretty == pretty) return;
+    
+    //as they are placed by BeginPiece: mei - meiHead - fileDesc - pubStmt, and mei - meiHead - encodingDesc
+    RenderHeaderTemplate(Scribe2MEIPubStmt(), 3, pretty, pubstmt_template);
+    RenderHeaderTemplate(Scribe2MEIEncoderDesc(), 2, pretty, encodingdesc_template);
+}
+
+//renders element, then deletes it
+void CScribeToNeoScribeXML::RenderHeaderTemplate(MeiElement* element, const int depth, const bool pretty, header_template& part)
+{
+    CMEISerializer::render(element, part.rendered, pretty, 2, depth);
+    
+    //the ids are rendered in document order, as AssignIds visits the elements
+    part.numbered.clear();
+    std::vector<MeiElement*> pending(1, element);
+    
+    while (!pending.empty())
+    {
+        MeiElement* next = pending.back();
+        pending.pop_back();
+        
+        part.numbered.push_back(!KeepsId(next));
+        
+        const std::vector<MeiElement*>& children = next->getChildren();
+        for (std::vector<MeiElement*>::const_reverse_iterator child = children.rbegin(); child != children.rend(); child++)
+            pending.push_back(*child);
+    }
+    
+    delete element;
+}
+
+//element, which is left without children, is written as part was rendered
+void CScribeToNeoScribeXML::StandIn(MeiElement* element, const header_template& part)
+{
+    header_stand_in standing = { element, &part, std::vector<std::string>() };
+    header_stand_ins.push_back(standing);
+}
+
+CScribeToNeoScribeXML::header_stand_in* CScribeToNeoScribeXML::FindStandIn(MeiElement* element)
+{
+    for (std::vector<header_stand_in>::iterator s = header_stand_ins.begin(); s != header_stand_ins.end(); s++)
+        if (s->element == element) return &*s;
+    
+    return NULL;
+}
+
+void CScribeToNeoScribeXML::SpliceHeader(CMEISerializer& serializer) const
+{
+    for (std::vector<header_stand_in>::const_iterator s = header_stand_ins.begin(); s != header_stand_ins.end(); s++)
+        serializer.stand_in(s->element, &s->part->rendered, s->ids.empty() ? NULL : &s->ids);
+}
+
+//ids set by the exporter itself, such as that of the staff group, are kept by AssignIds
+const bool CScribeToNeoScribeXML::KeepsId(MeiElement* element)
+{
+    return dynamic_cast<StaffGrp*>(element) != NULL || dynamic_cast<Application*>(element) != NULL;
+}
+
 WorkDesc* CScribeToNeoScribeXML::Scribe2MEIWorkDesc()
 {
     /*
@@ -498,16 +1070,19 @@ void    CScribeToNeoScribeXML::Scribe2MEIXMLFileData(FileDesc* fileDesc, const s
     composer->addAttribute("role", "composer"); //also add other attributes like dbkey, url
     composer->setValue(partit.composer);
     sourceRespStmt->addChild(composer);
-        //For later population
-    PersName* poet = new PersName;
-    poet->addAttribute("role", "poet");
-    poet->setValue("TBC");
-    sourceRespStmt->addChild(poet);
-        //for later population
-    PersName* dedicatee = new PersName;
-    dedicatee->addAttribute("role", "dedicatee");
-    dedicatee->setValue("TBC");
-    sourceRespStmt->addChild(dedicatee);
+        //For later population; placeholders are left out of compact output
+    if (!compact)
+    {
+        PersName* poet = new PersName;
+        poet->addAttribute("role", "poet");
+        poet->setValue("TBC");
+        sourceRespStmt->addChild(poet);
+            //for later population
+        PersName* dedicatee = new PersName;
+        dedicatee->addAttribute("role", "dedicatee");
+        dedicatee->setValue("TBC");
+        sourceRespStmt->addChild(dedicatee);
+    }
     
     source->addChild(sourceRespStmt);
     PhysLoc* physLoc = new PhysLoc;
@@ -546,408 +1121,522 @@ void    CScribeToNeoScribeXML::Scribe2MEIXMLWorkData(WorkDesc* workDesc, const s
 }
 
 
+//adds color and void attributes for coloration other than full black, to notes and ligatures
+void CScribeToNeoScribeXML::AddColoration(MeiElement* element, const coloration_type color) const
+{
+    switch (color) {
+        case full_red:
+            element->addAttribute("color", CAttributeValues::red);
+            break;
+        case void_red:
+            element->addAttribute("color", CAttributeValues::red);
+            element->addAttribute("void", CAttributeValues::true_value); //this seems a sensible solution for this problem and a suitable additional attribute to the MEI description
+            break;
+        case void_black:
+            element->addAttribute("void", CAttributeValues::true_value); //**
+            break;
+        case full_blue:
+            element->addAttribute("color", CAttributeValues::blue);
+            break;
+        default:
+            break;
+    }
+}
+
 //===================================================================================================
 //
-//  Function: Scribe2MEIXMLStaff
-//  Purpose: utility function to create MEI staff structure from scribe parts
-//  Used by: Scribe2MEIXML
-//  Inputs: scribe_part, staffgrp XML element pointer, i = count of parts in processed score
+//  Function: Scribe2MEIXMLNotes
+//  Purpose: utility function to add the notes of a Scribe event to its container - a syllable, uneume,
+//           ineume or ligature - whose kind determines how the notes are named and given durations
+//  Used by: Event
 //
 //===================================================================================================
 
-Staff* CScribeToNeoScribeXML::Scribe2MEIXMLStaff(const CScribeReaderVisitable& scribe_data, const scribe_part& partit, StaffGrp* staffgrp, const int i)
+template <scribe_type notation>
+void CScribeToNeoScribeXML::Scribe2MEIXMLNotes(const CScribeReaderVisitable& scribe_data, const scribe_event& event, MeiElement* foster, const container_t container, const coloration_type color, const scribe_pitch* pitches)
+{
+    for (auto i = event.pitch_num.begin(); i!=event.pitch_num.end(); i++)
+    {
+        int note_count = 1;
+        MeiElement* temp_foster = foster;
+        
+        //handle note attributes according to type
+        if ( container==ineume_container )
+        {
+            Uneume* temp_uneume = new Uneume;  //handle ineumes
+            //find uneume names
+            temp_uneume->addAttribute("name", CScribeReaderVisitable::get_ineume_part(event.code, i - event.pitch_num.begin(), note_count));
+            foster->addChild(temp_uneume);
+            temp_foster = temp_uneume; //allow notes to be children of uneume
+        } else if ((event.code=="B" || event.code=="V" || event.code=="L") && event.pitch_num.size()>1 && notation==chant && i!=event.pitch_num.begin()) //codes like virga and punctum may be followed by several pitch numbers, indicating a sequence of simple neumes
+        {
+            Uneume* temp_uneume = new Uneume;
+            temp_uneume->addAttribute("name", scribe_data.GetCodes()->code_to_name(event.code));
+            foster->getParent()->addChild(temp_uneume); //link to syllable element, not uneume!
+            temp_foster = temp_uneume;
+        }
+        //also handle ligatures
+        auto j = 0;
+        //insert note or notes for unneumes in ineumes
+        for (; j < note_count ; j++)
+        {
+            //convert note location to pitch name
+            // need to handle dots as element rather than attribute?
+            char pitch_name = pitches[i - event.pitch_num.begin()].name;
+            int octave = pitches[i - event.pitch_num.begin()].octave;
+            
+            Note* note = new Note;
+            if (container==syllable_container)
+            {
+                note->addAttribute("dur", scribe_data.GetCodes()->code_to_name(event.code));
+            }
+            else if (container==ligature_container)
+            {
+                note->addAttribute("dur", scribe_data.get_ligature_part(event.code, j));
+            }
+            note->addAttribute("pname", CAttributeValues::letter(pitch_name));
+            note->addAttribute("oct", CAttributeValues::number(octave));
+            //loc follows from pname and oct under the current clef, so compact output leaves it out
+            int note_loc = *i - 3; //3 is bottom line in Scribe, 0 in MEI
+            if (!compact) note->addAttribute("loc", CAttributeValues::number( note_loc ));
+            AddColoration(note, color);
+            temp_foster->addChild(note);
+        }
+        i+=j-1;
+    }
+}
+
+//===================================================================================================
+//
+//  Function: Scribe2MEIXMLStaffDef
+//  Purpose: utility function to create the MEI staff definition of a scribe part
+//  Used by: BeginPart, BeginStream
+//  Inputs: scribe_part, i = count of parts in processed score
+//
+//===================================================================================================
+
+StaffDef* CScribeToNeoScribeXML::Scribe2MEIXMLStaffDef(const scribe_part& partit, const int i)
 {
-    
     std::string staffnum("s");
     staffnum += std::to_string(i); //autogenerate staff ids
     
-    //finish score definitions
     //add staff definition for current part
     //NB. look to alternatively embedding these in staffs
     StaffDef* staffdef = new StaffDef;
     
     //define staff from data
-    staffgrp->addChild(staffdef);
     staffdef->addAttribute("id", staffnum);
-    staffdef->addAttribute("lines", std::to_string(partit.initial_staff_data.staff_lines));
+    staffdef->addAttribute("lines", CAttributeValues::number(partit.initial_staff_data.staff_lines));
     staffdef->addAttribute("label", CScribeCodes::voice_labels[partit.voice_type].c_str());
     
     //define clef from data
     Clef* clef = new Clef;
     staffdef->addChild(clef);
     
-    scribe_clef loc_clef;
-    loc_clef.clef_line = partit.initial_staff_data.clef_line;
-    loc_clef.clef = partit.initial_staff_data.clef;
     //convert scribe-based clef position to mei
     //int mei_clef_line = ((loc_clef.clef_line + 1)/2) - 1; = incorrect
-    int mei_clef_line = 1 + (loc_clef.clef_line-3)/2;
+    int mei_clef_line = 1 + (partit.initial_staff_data.clef_line-3)/2;
     //4-line staves are numbered 3, 5, 7, 9 in scribe
     //if (partit->staff_lines<=4) mei_clef_line -= (5 - partit->staff_lines);
     
-    clef->addAttribute("line", std::to_string(mei_clef_line)); //these need to be set for each staff/part
-    clef->addAttribute("shape", std::string(&(partit.initial_staff_data.clef),1).c_str()); //the first event in stored memory should be the initial clef
+    clef->addAttribute("line", CAttributeValues::number(mei_clef_line)); //these need to be set for each staff/part
+    clef->addAttribute("shape", CAttributeValues::letter(partit.initial_staff_data.clef)); //the first event in stored memory should be the initial clef
+    
+    return staffdef;
+}
+
+//===================================================================================================
+//
+//  Function: SetStaffDefaults
+//  Purpose: utility function for compact output, which gives the staff definition of a part the octave
+//           and duration most common among the notes of its staff as defaults, and removes them from
+//           the notes that have them. A duration default is only given if every note has a duration,
+//           since a note without one would otherwise take the default.
+//  Used by: EndPart
+//
+//===================================================================================================
+
+void CScribeToNeoScribeXML::SetStaffDefaults(StaffDef* staffdef, Staff* staff) const
+{
+    std::vector<MeiElement*> notes;
+    std::vector<MeiElement*> pending(1, staff);
+    
+    while (!pending.empty())
+    {
+        MeiElement* element = pending.back();
+        pending.pop_back();
+        
+        if (dynamic_cast<Note*>(element)) notes.push_back(element);
+        
+        const std::vector<MeiElement*>& children = element->getChildren();
+        pending.insert(pending.end(), children.begin(), children.end());
+    }
+    
+    //attribute of the notes, attribute of the staff definition
+    const std::pair<std::string, std::string> defaults[] = { std::make_pair("oct", "octave.default"), std::make_pair("dur", "dur.default") };
+    
+    for (const std::pair<std::string, std::string>& attribute : defaults)
+    {
+        std::map<std::string, int> counts;
+        bool on_every_note = true;
+        
+        for (MeiElement* note : notes)
+        {
+            if (note->hasAttribute(attribute.first)) counts[note->getAttribute(attribute.first)->getValue()]++;
+            else on_every_note = false;
+        }
+        
+        if (!on_every_note || counts.empty()) continue;
+        
+        std::map<std::string, int>::const_iterator most = counts.begin();
+        for (std::map<std::string, int>::const_iterator c = counts.begin(); c != counts.end(); c++)
+            if (c->second > most->second) most = c;
+        
+        //a default given once saves nothing
+        if (most->second < 2) continue;
+        
+        staffdef->addAttribute(attribute.second, most->first);
+        for (MeiElement* note : notes)
+            if (note->getAttribute(attribute.first)->getValue() == most->first) note->removeAttribute(attribute.first);
+    }
+}
+
+//===================================================================================================
+//
+//  Functions:  BeginPart, Row, Event, EndPart
+//  Purpose:    Build the staff of each part of a piece being converted, as CScribeTraversal passes over
+//              the parts, rows and events of a Scribe file. BeginPart begins a piece at its first part,
+//              and EndPart adds the staff to the piece in a section of its own, or when streaming, writes
+//              the section and deletes it; the last part of a piece ends it. Parts not in a piece being
+//              converted are passed over.
+//  Used by:    CScribeTraversal, Scribe2MEIXML, SegmentScribe2MEIXML
+//
+//===================================================================================================
+
+template <scribe_type notation>
+void CScribeToNeoScribeXML::BeginPart(const CScribeReaderVisitable&, const scribe_part& partit)
+{
+    if (next_piece < pieces.size() && &partit == &*pieces[next_piece].first) BeginPiece(pieces[next_piece]);
+    
+    if (!piece_score) return;
+    
+    std::string staffnum("s");
+    staffnum += std::to_string(staff_number); //autogenerate staff ids
+    
+    //finish score definitions, unless they were made before the staff (see BeginStream)
+    current_staffdef = NULL;
+    if (!stream)
+    {
+        current_staffdef = Scribe2MEIXMLStaffDef(partit, staff_number);
+        piece_staffgrp->addChild(current_staffdef);
+    }
+    
+    current_part = &partit;
     
-    Staff* staff = new Staff;
+    current_staff = new Staff;
     
-    staff->addAttribute("id", staffnum);
-    staff->addAttribute("source", partit.abbrev_ms);
+    current_staff->addAttribute("id", staffnum);
+    current_staff->addAttribute("source", partit.abbrev_ms);
     //folio on which part appears
     
     Pb* pb = new Pb; //new ELEMENT?
-    staff->addChild(pb);
+    current_staff->addChild(pb);
     pb->addAttribute("n", partit.folios);
     //first staff on which part appears
-    Sb* sb = new Sb;
-    sb->addAttribute("n", "0"); //set to "0" since this isn't encoded in scribe; data will need to be enhanced later
-    staff->addChild(sb);
+    if (!compact)
+    {
+        Sb* sb = new Sb;
+        sb->addAttribute("n", "0"); //set to "0" since this isn't encoded in scribe; data will need to be enhanced later
+        current_staff->addChild(sb);
+    }
+    
+    current_color = coloration_type::full_black; // this needs to be better handled with a default coloration in a part
+}
+
+template <scribe_type notation>
+void CScribeToNeoScribeXML::Row(const scribe_row& row)
+{
+    current_syllable = NULL;
+    current_row = &row;
+    event_index = 0;
+    next_group = 0;
+    current_ineume = NULL;
+    
+    if (!current_staff) return;
+    
+    if (row.is_comment) {
+        //check it this is the correct way to handle a comment
+        
+        MeiCommentNode* comment = new MeiCommentNode;
+        comment->setValue(row.comment);
+        current_staff->addChild(comment);
+        //NB. syl can have a type (eg. initial) attribute and also encode color as <rend> child element
+    } else {
+        
+        //syllable container (holds syllables, notes, neumes, and ligatures)
+        current_syllable = new Syllable; //neumes.h
+        current_staff->addChild(current_syllable);
+        
+        //add actual syllable if present
+        if (!row.syllable.empty()) {
+            Syl* syl = new Syl;
+            syl->setValue(row.syllable);
+            current_syllable->addChild(syl);
+        }
+    }
+}
+
+//extract events - notes, rests ligatures, uneumes and/or ligatures - into the syllable of their row
+template <scribe_type notation>
+void CScribeToNeoScribeXML::Event(const scribe_event& event)
+{
+    const size_t index = event_index++;
     
-    coloration_type current_color = coloration_type::full_black; // this needs to be better handled with a default coloration in a part
+    if (!current_syllable) return;
     
-    for (std::vector<scribe_row>::const_iterator rowit = partit.rows.begin(); rowit!=partit.rows.end(); rowit++)
+    current_color = event.local_coloration;
+    
+    //use temp TiXML pointer which is either syllable, uneume/ineume or ligature - add notes to this, but make sure that uneume/inueme/ligature pointer is preinserted into syllable
+    //handle events for each row
+    code_t event_type = current_data->GetCodes()->get_code_type(event.code);//codes->get_code_type(event.code);
+    //pitches of the numbers of the event, resolved by the reader (see resolve_pitches)
+    const scribe_pitch* pitches = current_part->pitches.data() + event.first_pitch;
+    //foster parent will change roles according to child elements that need to be added; its kind is tracked alongside
+    MeiElement* foster = current_syllable;
+    container_t container = syllable_container;
+    
+    switch (event_type)
     {
-        if (rowit->is_comment) {
-            //check it this is the correct way to handle a comment
-            
-            MeiCommentNode* comment = new MeiCommentNode;
-            comment->setValue(rowit->comment);
-            staff->addChild(comment);
-            //NB. syl can have a type (eg. initial) attribute and also encode color as <rend> child element
-        } else {
-            
-            //syllable container (holds syllables, notes, neumes, and ligatures)
-            Syllable* syllable = new Syllable; //neumes.h
-            staff->addChild(syllable);
+        case code_t::ineume:
+        {
+            //an ineume joined to the one before it without a gap continues its compound neume (see read_scribe_row)
+            const std::vector<std::pair<size_t, size_t> >& groups = current_row->neume_groups;
+            while (next_group < groups.size() && groups[next_group].second <= index) next_group++;
             
-            //add actual syllable if present
-            if (!rowit->syllable.empty()) {
-                Syl* syl = new Syl;
-                syl->setValue(rowit->syllable);
-                syllable->addChild(syl);
+            if (!current_ineume || next_group == groups.size() || groups[next_group].first >= index)
+            {
+                current_ineume = new Ineume;
+                //current_ineume->addAttribute("name", current_data->GetCodes()->code_to_name(event.code));
+                foster->addChild(current_ineume);
             }
+            foster = current_ineume;
+            container = ineume_container;
             
-            //extract events - notes, rests ligatures, uneumes and/or ligatures
-            for (std::vector<scribe_event>::const_iterator eventit = rowit->events.begin(); eventit!=rowit->events.end(); eventit++ )
+            Scribe2MEIXMLNotes<notation>(*current_data, event, foster, container, current_color, pitches);
+            break;
+        }
+        case code_t::uneume:
+        {
+            Uneume* uneume = new Uneume;
+            uneume->addAttribute("name", current_data->GetCodes()->code_to_name(event.code));
+            foster->addChild(uneume);
+            foster = uneume;
+            container = uneume_container;
+            Scribe2MEIXMLNotes<notation>(*current_data, event, foster, container, current_color, pitches);
+            break;
+        }
+        case code_t::ligature:
+        {
+            Ligature* ligature = new Ligature; //mensural.h
+            ligature->addAttribute("name", current_data->GetCodes()->code_to_name(event.code));
+            foster->addChild(ligature);
+            foster = ligature;
+            container = ligature_container;
+            AddColoration(ligature, current_color);
+            Scribe2MEIXMLNotes<notation>(*current_data, event, foster, container, current_color, pitches);
+            break;
+        }
+        case code_t::note:
+            Scribe2MEIXMLNotes<notation>(*current_data, event, foster, container, current_color, pitches);
+            break;
+            //dot needs to be handled as a unique element in our extended definition
+            /*Stinson, 7 July 2013: Further notes on DOT
+             The code has two arguments: the first is the substantive position on the staff; the second refines that position up or down and is capable of five variants: 0 = exactly on the line or exactly in the middle of the space between the lines; -1 = 0.1 of the space between the lines below (or for +, above) the space or line; -2= 0.2 of the space below the normal position for that line or space; -3 = 0.3 below the normal position; -4 = 0.4 below the normal position.
+             Only values between 0 and 4 are permitted as the second argument as 5 would be the equivalent of having the dot on the next numbered line or space, e.g. '7 -5', if it were permitted, would be the same as '6 0'.*/
+        case code_t::dot:
+        {
+            Dot* dot = new Dot;
+            char pitch_name = pitches[0].name;
+            int octave = pitches[0].octave;
+            dot->addAttribute("ploc", CAttributeValues::letter(pitch_name));
+            dot->addAttribute("oloc", CAttributeValues::number(octave));
+            /*vo: records the vertical adjustment of a feature's programmatically-determined location in terms of staff interline distance; that is, in units of 1/2 the distance between adjacent staff lines. (MEI2013)*/
+            //only set for non-defult positions
+            if (event.pitch_num[1]!=0)
             {
-                current_color = eventit->local_coloration;
-                
-                //use temp TiXML pointer which is either syllable, uneume/ineume or ligature - add notes to this, but make sure that uneume/inueme/ligature pointer is preinserted into syllable
-                //handle events for each row
-                code_t event_type = scribe_data.GetCodes()->get_code_type(eventit->code);//codes->get_code_type(eventit->code);
-                //foster parent will change roles according to child elements that need to be added
-                MeiElement* foster = syllable;
-                
-                switch (event_type)
+                dot->addAttribute("vo", CAttributeValues::vertical_offset(event.pitch_num[1]));
+            }
+            foster->addChild(dot);
+        }
+            break;
+        case code_t::rest:
+        {
+            Rest* rest = new Rest;
+            foster->addChild(rest);
+            switch (*(event.code.c_str())) {
+                    //rests of type 'R' has two associated pitch numbers from which we might infer the type
+                case generic_rest:
                 {
-                    case code_t::ineume:
-                    {
-#ifdef IGNOREGAPS
-                        Ineume* ineume = new Ineume;
-                        //ineume->addAttribute("name", scribe_data.GetCodes()->code_to_name(eventit->code));
-                        foster->addChild(ineume);
-                        foster = ineume;
-                        
-#else                   //this needs work, hence excluded
-                        if (!eventit->preceding_gap || foster->getChildren().empty())
-                        {
-                            Ineume* ineume = new Ineume;
-                            //ineume->addAttribute("name", scribe_data.GetCodes()->code_to_name(eventit->code));
-                            foster->addChild(ineume);
-                            foster = ineume;
-                        }
-                        else
-                        {
-                            MeiElement* lastNeume = foster->getChildren().back();
-                            if (lastNeume->getName() == "ineume")
-                            {
-                                Ineume* newNeume = new Ineume(*dynamic_cast<Ineume*>(lastNeume));
-                                /*for (std::vector<MeiElement*>::const_iterator child = lastNeume->getChildren().begin(); child!=lastNeume->getChildren().end(); child++ ) {
-                                    MeiElement* clone = new MeiElement(**child);
-                                    newNeume->addChild(clone);
-                                }*/
-                                foster->removeChild(lastNeume);
-                                foster->addChild(newNeume);
-                                //delete lastNeume;
-                                foster = newNeume;
-                            }
-                            else
-                                foster = lastNeume;
-                        }
-#endif
-                        goto do_note;
-                        break;
-                    }
-                    case code_t::uneume:
-                    {
-                        Uneume* uneume = new Uneume;
-                        uneume->addAttribute("name", scribe_data.GetCodes()->code_to_name(eventit->code));
-                        foster->addChild(uneume);
-                        foster = uneume;
-                        goto do_note;
-                        break;
-                    }
-                    case code_t::ligature:
-                    {
-                        Ligature* ligature = new Ligature; //mensural.h
-                        ligature->addAttribute("name", scribe_data.GetCodes()->code_to_name(eventit->code));
-                        foster->addChild(ligature);
-                        foster = ligature;
-                        if (current_color!=coloration_type::full_black)
-                        {
-                            switch (current_color) {
-                                case full_red:
-                                    ligature->addAttribute("color", "red");
-                                    break;
-                                case void_red:
-                                    ligature->addAttribute("color", "red");
-                                    ligature->addAttribute("void", "true"); //this seems a sensible solution for this problem and a suitable additional attribute to the MEI description
-                                    break;
-                                case void_black:
-                                    ligature->addAttribute("void", "true"); //**
-                                    break;
-                                case full_blue:
-                                    ligature->addAttribute("color", "blue");
-                                    break;
-                                default:
-                                    break;
-                            }
-                        }
-                        //goto do_note;
-                        //break;
-                    }
-                    case code_t::note:
-                    do_note:
-                    {
-                        for (auto i = eventit->pitch_num.begin(); i!=eventit->pitch_num.end(); i++)
-                        {
-                            int note_count = 1;
-                            MeiElement* temp_foster = foster;
-                            
-                            //handle note attributes according to type
-                            if ( foster->getName()=="ineume" )
-                            {
-                                Uneume* temp_uneume = new Uneume;  //handle ineumes
-                                //find uneume names
-                                temp_uneume->addAttribute("name", CScribeReaderVisitable::get_ineume_part(eventit->code, i - eventit->pitch_num.begin(), note_count));
-                                foster->addChild(temp_uneume);
-                                temp_foster = temp_uneume; //allow notes to be children of uneume
-                            } else if ((eventit->code=="B" || eventit->code=="V" || eventit->code=="L") && eventit->pitch_num.size()>1 && scribe_data.GetType()==chant && i!=eventit->pitch_num.begin()) //codes like virga and punctum may be followed by several pitch numbers, indicating a sequence of simple neumes
-                            {
-                                Uneume* temp_uneume = new Uneume;
-                                temp_uneume->addAttribute("name", scribe_data.GetCodes()->code_to_name(eventit->code));
-                                foster->getParent()->addChild(temp_uneume); //link to syllable element, not uneume!
-                                temp_foster = temp_uneume;
-                            }
-                            //also handle ligatures
-                            auto j = 0;
-                            //insert note or notes for unneumes in ineumes
-                            for (; j < note_count ; j++)
-                            {
-                                //convert note location to pitch name
-                                // need to handle dots as element rather than attribute?
-                                char pitch_name = loc_clef.get_pitch_name(*i);
-                                int octave = loc_clef.get_octave(*i);
-                                
-                                Note* note = new Note;
-                                if (foster->getName()=="syllable")
-                                {
-                                    note->addAttribute("dur", scribe_data.GetCodes()->code_to_name(eventit->code));
-                                }
-                                else if (foster->getName()=="ligature")
-                                {
-                                    note->addAttribute("dur", scribe_data.get_ligature_part(eventit->code, j));
-                                }
-                                note->addAttribute("pname", std::string(&pitch_name,1));
-                                note->addAttribute("oct", std::to_string(octave));
-                                int note_loc = *i - 3; //3 is bottom line in Scribe, 0 in MEI
-                                note->addAttribute("loc", std::to_string( note_loc ));
-                                if (current_color!=coloration_type::full_black)
-                                {
-                                    switch (current_color) {
-                                        case full_red:
-                                            note->addAttribute("color", "red");
-                                            break;
-                                        case void_red:
-                                            note->addAttribute("color", "red");
-                                            note->addAttribute("void", "true"); //this seems a sensible solution for this problem and a suitable additional attribute to the MEI description
-                                            break;
-                                        case void_black:
-                                            note->addAttribute("void", "true"); //**
-                                            break;
-                                        case full_blue:
-                                            note->addAttribute("color", "blue");
-                                            break;
-                                        default:
-                                            break;
-                                    }
-                                }
-                                temp_foster->addChild(note);
-                            }
-                            i+=j-1;
-                        }
+                    int end = event.pitch_num[0];
+                    int start = event.pitch_num[1];
+                    int rest_type = start-end;
+                    switch (rest_type) {
+                        case minim_rest:
+                            rest->addAttribute("type", "minima");
+                            break;
+                        case semibreve_rest:
+                            rest->addAttribute("type", "semibrevis");
+                            break;
+                        case breve_rest:
+                            rest->addAttribute("type", "brevis");
+                            break;
+                        case long_rest:
+                            rest->addAttribute("type", "longa imperfecta");
+                            break;
+                        case perf_long_rest:
+                            rest->addAttribute("type", "long perfecta");
+                            break;
+                        default:
+                            break;
                     }
-                        break;
-                        //dot needs to be handled as a unique element in our extended definition
-                        /*Stinson, 7 July 2013: Further notes on DOT
-                         The code has two arguments: the first is the substantive position on the staff; the second refines that position up or down and is capable of five variants: 0 = exactly on the line or exactly in the middle of the space between the lines; -1 = 0.1 of the space between the lines below (or for +, above) the space or line; -2= 0.2 of the space below the normal position for that line or space; -3 = 0.3 below the normal position; -4 = 0.4 below the normal position.
-                         Only values between 0 and 4 are permitted as the second argument as 5 would be the equivalent of having the dot on the next numbered line or space, e.g. '7 -5', if it were permitted, would be the same as '6 0'.*/
-                    case code_t::dot:
-                    {
-                        Dot* dot = new Dot;
-                        char pitch_name = loc_clef.get_pitch_name(eventit->pitch_num[0]);
-                        int octave = loc_clef.get_octave(eventit->pitch_num[0]);
-                        dot->addAttribute("ploc", std::string(&pitch_name,1));
-                        dot->addAttribute("oloc", std::to_string(octave));
-                        /*vo: records the vertical adjustment of a feature's programmatically-determined location in terms of staff interline distance; that is, in units of 1/2 the distance between adjacent staff lines. (MEI2013)*/
-                        //only set for non-defult positions
-                        if (eventit->pitch_num[1]!=0)
-                        {
-                            float v_pos = eventit->pitch_num[1]/10.0*2;
-                            dot->addAttribute("vo", to_string_with_precision(v_pos,1));
-                        }
-                        foster->addChild(dot);
-                    }
-                        break;
-                    case code_t::rest:
-                    {
-                        Rest* rest = new Rest;
-                        foster->addChild(rest);
-                        switch (*(eventit->code.c_str())) {
-                                //rests of type 'R' has two associated pitch numbers from which we might infer the type
-                            case generic_rest:
-                            {
-                                int end = eventit->pitch_num[0];
-                                int start = eventit->pitch_num[1];
-                                int rest_type = start-end;
-                                switch (rest_type) {
-                                    case minim_rest:
-                                        rest->addAttribute("type", "minima");
-                                        break;
-                                    case semibreve_rest:
-                                        rest->addAttribute("type", "semibrevis");
-                                        break;
-                                    case breve_rest:
-                                        rest->addAttribute("type", "brevis");
-                                        break;
-                                    case long_rest:
-                                        rest->addAttribute("type", "longa imperfecta");
-                                        break;
-                                    case perf_long_rest:
-                                        rest->addAttribute("type", "long perfecta");
-                                        break;
-                                    default:
-                                        break;
-                                }
-                                char ploc = loc_clef.get_pitch_name(start);
-                                rest->addAttribute("ploc", std::string(&ploc,1));
-                                rest->addAttribute("oloc", std::to_string(loc_clef.get_octave(start)));
-                                break;
-                                //also process 'RSM', semiminim rest
-                            }
-                                //case semiminim_rest:
-                                //rest->SetAttribute("type", "semiminim");
-                                //    break;
-                            default:
-                                rest->addAttribute("type", scribe_data.GetCodes()->code_to_name(eventit->code));
-                                if (!eventit->pitch_num.empty()) {
-                                    char pitch_name = loc_clef.get_pitch_name(eventit->pitch_num[0]);
-                                    int octave = loc_clef.get_octave(eventit->pitch_num[0]);
-                                    rest->addAttribute("ploc", std::string(&pitch_name,1));
-                                    rest->addAttribute("oloc", std::to_string(octave));
-                                }
-                                break;
-                        }
-                    }
-                        break;
-                    // non-standard mensuration signs
-                    case code_t::mensuration:
-                    {
-                        Mensur* mensuration_sign = new Mensur;
-                        foster->addChild(mensuration_sign);
-                        
-                        if (eventit->code == "MO" || eventit->code == "MC" || eventit->code == "MO." || eventit->code == "MC.")
-                        {
-                            char the_sign = eventit->code[1];
-                            mensuration_sign->addAttribute("sign", std::string(&the_sign,1));
-                            if (eventit->code.size()==3 && eventit->code[2]=='.') {
-                                mensuration_sign->addAttribute("dot", "true");
-                            }
-                            //also able to set attribute 'orient' to reversed for reversed signs; and slash attribute for cut signs
-                        }
-                        if (eventit->code == ".D." || eventit->code == ".Q." || eventit->code == ".SI." || eventit->code == ".P." || eventit->code == ".N." || eventit->code == ".O." || eventit->code == ".I.") //also .SG.?
-                        {
-                            //these are wholly new to the MEI schema; the whole dot-letter-dot sign is encoded
-                            mensuration_sign->addAttribute("sign", eventit->code);
-                        }
-                        break;
-                    }
-                    case code_t::barline:
-                    {
-                        BarLine* barline = new BarLine;
-                        foster->addChild(barline);
-                        if (eventit->code == "QBAR") {
-                            
-                            barline->addAttribute("rend", "quarter"); //non-standard data type for rend.
-                        }
-                        if (eventit->code == "HBAR") {
-                            
-                            barline->addAttribute("rend", "half");
-                        }
-                        if (eventit->code == "WBAR") {
-                            
-                            barline->addAttribute("rend", "single");
-                        }
-                        if (eventit->code == "DBAR") {
-                            
-                            barline->addAttribute("rend", "dbl");
-                        }
-                        
-                        //modern bar editorial - ignore?
-                        if (eventit->code == "MBAR") {
-                            
-                            barline->addAttribute("barplace", "takt");
-                            barline->addAttribute("taktplace", std::string(9,1));
-                        }
-                        
-                        //also able to see rend attribute
-                        
-                        break;
-                    }
-                    case code_t::clef:
-                    {
-                        //NB. old clefchange element superceded; clefGrp used for simultaneous clefs
-                        loc_clef.clef_line = *(eventit->pitch_num.begin());
-                        loc_clef.clef = *(eventit->code.c_str());
-                        Clef* clef = new Clef;
-                        clef->addAttribute("line", std::to_string( ((loc_clef.clef_line + 1)/2) - 1));
-                        clef->addAttribute("shape", std::string(&(loc_clef.clef),1).c_str());
-                        foster->addChild(clef);
-                        break;
-                    }
-                        //The MEI accidental names are not used: diesis, b-rotundum and b-quadratum are. Other variants may be added. All ms accidentials in Scribe (as they should be in NeoScribe) are independent elements
-                    case code_t::accidental:
-                    {
-                        Accid* accid = new Accid;
-                        accid->addAttribute("accidental", scribe_data.GetCodes()->code_to_name(eventit->code));
-                        if (!eventit->pitch_num.empty()) {
-                            char ploc = loc_clef.get_pitch_name(eventit->pitch_num[0]);
-                            int oloc = loc_clef.get_octave(eventit->pitch_num[0]);
-                            accid->addAttribute("ploc", std::string(&ploc,1));
-                            accid->addAttribute("oloc", std::to_string(oloc));
-                        }
-                        foster->addChild(accid);
-                        break;
+                    char ploc = pitches[1].name; //of start
+                    rest->addAttribute("ploc", CAttributeValues::letter(ploc));
+                    rest->addAttribute("oloc", CAttributeValues::number(pitches[1].octave));
+                    break;
+                    //also process 'RSM', semiminim rest
+                }
+                    //case semiminim_rest:
+                    //rest->SetAttribute("type", "semiminim");
+                    //    break;
+                default:
+                    rest->addAttribute("type", current_data->GetCodes()->code_to_name(event.code));
+                    if (!event.pitch_num.empty()) {
+                        char pitch_name = pitches[0].name;
+                        int octave = pitches[0].octave;
+                        rest->addAttribute("ploc", CAttributeValues::letter(pitch_name));
+                        rest->addAttribute("oloc", CAttributeValues::number(octave));
                     }
-                    case code_t::other:
-                        //lucunae
-                    default:
-                        break;
+                    break;
+            }
+        }
+            break;
+        // non-standard mensuration signs
+        case code_t::mensuration:
+        {
+            Mensur* mensuration_sign = new Mensur;
+            foster->addChild(mensuration_sign);
+            
+            if (event.code == "MO" || event.code == "MC" || event.code == "MO." || event.code == "MC.")
+            {
+                char the_sign = event.code[1];
+                mensuration_sign->addAttribute("sign", CAttributeValues::letter(the_sign));
+                if (event.code.size()==3 && event.code[2]=='.') {
+                    mensuration_sign->addAttribute("dot", CAttributeValues::true_value);
                 }
+                //also able to set attribute 'orient' to reversed for reversed signs; and slash attribute for cut signs
+            }
+            if (event.code == ".D." || event.code == ".Q." || event.code == ".SI." || event.code == ".P." || event.code == ".N." || event.code == ".O." || event.code == ".I.") //also .SG.?
+            {
+                //these are wholly new to the MEI schema; the whole dot-letter-dot sign is encoded
+                mensuration_sign->addAttribute("sign", event.code);
+            }
+            break;
+        }
+        case code_t::barline:
+        {
+            BarLine* barline = new BarLine;
+            foster->addChild(barline);
+            if (event.code == "QBAR") {
+                
+                barline->addAttribute("rend", "quarter"); //non-standard data type for rend.
+            }
+            if (event.code == "HBAR") {
+                
+                barline->addAttribute("rend", "half");
+            }
+            if (event.code == "WBAR") {
+                
+                barline->addAttribute("rend", "single");
+            }
+            if (event.code == "DBAR") {
+                
+                barline->addAttribute("rend", "dbl");
+            }
+            
+            //modern bar editorial - ignore?
+            if (event.code == "MBAR") {
                 
+                barline->addAttribute("barplace", "takt");
+                barline->addAttribute("taktplace", std::string(9,1));
             }
             
+            //also able to see rend attribute
+            
+            break;
+        }
+        case code_t::clef:
+        {
+            //NB. old clefchange element superceded; clefGrp used for simultaneous clefs
+            //the reader has already applied the change to the pitches of the events that follow
+            Clef* clef = new Clef;
+            clef->addAttribute("line", CAttributeValues::number( ((pitches[0].clef_line + 1)/2) - 1));
+            clef->addAttribute("shape", CAttributeValues::letter(pitches[0].clef));
+            foster->addChild(clef);
+            break;
         }
+            //The MEI accidental names are not used: diesis, b-rotundum and b-quadratum are. Other variants may be added. All ms accidentials in Scribe (as they should be in NeoScribe) are independent elements
+        case code_t::accidental:
+        {
+            Accid* accid = new Accid;
+            accid->addAttribute("accidental", current_data->GetCodes()->code_to_name(event.code));
+            if (!event.pitch_num.empty()) {
+                char ploc = pitches[0].name;
+                int oloc = pitches[0].octave;
+                accid->addAttribute("ploc", CAttributeValues::letter(ploc));
+                accid->addAttribute("oloc", CAttributeValues::number(oloc));
+            }
+            foster->addChild(accid);
+            break;
+        }
+        case code_t::other:
+            //lucunae
+        default:
+            break;
+    }
+}
+
+template <scribe_type notation>
+void CScribeToNeoScribeXML::EndPart(const scribe_part& partit)
+{
+    if (!current_staff) return;
+    
+    if (compact && current_staffdef) SetStaffDefaults(current_staffdef, current_staff);
+    
+    Section* section = new Section;
+    section->addChild(current_staff);
+    current_staff = NULL;
+    current_syllable = NULL;
+    staff_number++;
+    
+    if (!stream)
+        piece_score->addChild(section);
+    else
+    {
+        if (deterministic_ids) AssignIds(section, stream_count, stream_staff_count);
+        stream->write(section);
+        delete section;
+        FlushStream();
     }
     
-    return staff;
+    if (&partit == &*(pieces[next_piece].last - 1)) EndPiece(pieces[next_piece++]);
 }
+
+//the hooks are called from other files through CScribeTraversal
+template void CScribeToNeoScribeXML::BeginPart<chant>(const CScribeReaderVisitable& scribe_data, const scribe_part& partit);
+template void CScribeToNeoScribeXML::BeginPart<trecento>(const CScribeReaderVisitable& scribe_data, const scribe_part& partit);
+template void CScribeToNeoScribeXML::Row<chant>(const scribe_row& row);
+template void CScribeToNeoScribeXML::Row<trecento>(const scribe_row& row);
+template void CScribeToNeoScribeXML::Event<chant>(const scribe_event& event);
+template void CScribeToNeoScribeXML::Event<trecento>(const scribe_event& event);
+template void CScribeToNeoScribeXML::EndPart<chant>(const scribe_part& partit);
+template void CScribeToNeoScribeXML::EndPart<trecento>(const scribe_part& partit);
@@ -0,0 +1,362 @@
+//
+//  CScribeWatcher.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  On Linux changes are reported by inotify. Editors and copy tools write files in several steps, so a file
+//  is only queued once no further event has arrived for it during the debounce interval. Elsewhere the
+//  directory is scanned for changed modification times at the same interval.
+//
+
+#include "CScribeWatcher.h"
+#include "CScribeReaderVisitable.h"
+#include "CScribeToNeoScribeXML.h"
+#include "CManifest.h"
+
+#include <exception>
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+
+CScribeWatcher::CScribeWatcher(const std::string& directory, const std::string& encoder_name, const int workers, const int debounce_ms)
+: directory(directory), encoder(encoder_name), worker_count(std::max(1, workers)), debounce(debounce_ms)
+{
+    if (!this->directory.empty() && this->directory.back()!='/') this->directory.push_back('/');
+    manifest = new CManifest(MANIFEST_FILE);
+}
+
+CScribeWatcher::~CScribeWatcher()
+{
+    //workers only stop with the process; if watching failed, let them finish their current file
+    for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); w++)
+        if (w->joinable()) w->detach();
+    delete manifest;
+}
+
+//===================================================================================================
+//
+//  Function:   Run
+//  Purpose:    Starts the worker threads, queues every Scribe file already in the directory (files that
+//              are current are skipped cheaply) and then converts files as they change
+//  Used by:    none - public function call
+//
+//===================================================================================================
+
+void CScribeWatcher::Run()
+{
+    std::map<std::string, time_t> modified_times;
+    ScanDirectory(&modified_times);
+    
+    for (int i = 0; i < worker_count; i++)
+        workers.push_back(std::thread(&CScribeWatcher::Worker, this));
+    
+    for (std::map<std::string, time_t>::const_iterator f = modified_times.begin(); f != modified_times.end(); f++)
+        Queue(f->first);
+    
+    std::cout << "Watching " << directory << " for changed Scribe files..." << std::endl;
+    
+    WatchEvents();
+}
+
+#ifdef __linux__
+
+void CScribeWatcher::WatchEvents()
+{
+    int fd = inotify_init1(IN_CLOEXEC);
+    
+    if (fd < 0 || inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY | IN_DELETE | IN_MOVED_FROM) < 0)
+        throw std::runtime_error("Could not watch directory " + directory);
+    
+    alignas(struct inotify_event) char buffer[65536];
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    
+    for (;;)
+    {
+        //wake at least once per debounce interval while changes are pending
+        int timeout = pending.empty() ? -1 : static_cast<int>(debounce.count());
+        int ready = poll(&pfd, 1, timeout);
+        
+        if (ready > 0)
+        {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            
+            for (ssize_t pos = 0; pos < length; )
+            {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + pos);
+                
+                //events were dropped, deletions among them, so the directory is looked at afresh
+                if (event->mask & IN_Q_OVERFLOW)
+                    Rescan();
+                else if (event->len > 0 && IsScribeFile(event->name))
+                {
+                    std::string file_name = directory + event->name;
+                    
+                    if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                        Forget(file_name);
+                    else
+                        Touch(file_name);
+                }
+                pos += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        
+        QueueSettled();
+    }
+}
+
+#else
+
+//no change notification available - compare modification times once per debounce interval
+void CScribeWatcher::WatchEvents()
+{
+    std::map<std::string, time_t> modified_times;
+    ScanDirectory(&modified_times);
+    
+    for (;;)
+    {
+        std::this_thread::sleep_for(debounce);
+        
+        std::map<std::string, time_t> now_times;
+        ScanDirectory(&now_times);
+        
+        for (std::map<std::string, time_t>::const_iterator f = now_times.begin(); f != now_times.end(); f++)
+        {
+            std::map<std::string, time_t>::const_iterator before = modified_times.find(f->first);
+            if (before == modified_times.end() || before->second != f->second) Touch(f->first);
+        }
+        
+        for (std::map<std::string, time_t>::const_iterator f = modified_times.begin(); f != modified_times.end(); f++)
+            if (now_times.find(f->first) == now_times.end()) Forget(f->first);
+        
+        modified_times.swap(now_times);
+        
+        QueueSettled();
+    }
+}
+
+#endif
+
+//lists Scribe files in the watched directory with their modification times
+void CScribeWatcher::ScanDirectory(std::map<std::string, time_t>* modified_times)
+{
+    DIR* dir = opendir(directory.c_str());
+    
+    if (dir == NULL) throw std::runtime_error("Could not open directory " + directory);
+    
+    while (struct dirent* entry = readdir(dir))
+    {
+        if (!IsScribeFile(entry->d_name)) continue;
+        
+        std::string file_name = directory + entry->d_name;
+        struct stat info;
+        
+        if (stat(file_name.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            (*modified_times)[file_name] = info.st_mtime;
+    }
+    
+    closedir(dir);
+}
+
+//===================================================================================================
+//
+//  Function:   Rescan
+//  Purpose:    Brings the watcher up to date with the directory after inotify has dropped events. Every
+//              Scribe file present is treated as changed (conversion of an unchanged file writes nothing),
+//              and files no longer present are forgotten along with their parsed models
+//  Used by:    WatchEvents
+//
+//===================================================================================================
+
+void CScribeWatcher::Rescan()
+{
+    std::map<std::string, time_t> modified_times;
+    ScanDirectory(&modified_times);
+    
+    std::vector<std::string> gone;
+    
+    {
+        std::lock_guard<std::mutex> guard(reader_lock);
+        for (std::map<std::string, std::shared_ptr<CScribeReaderVisitable> >::const_iterator r = readers.begin(); r != readers.end(); r++)
+            if (modified_times.find(r->first) == modified_times.end()) gone.push_back(r->first);
+    }
+    
+    for (std::map<std::string, watch_clock::time_point>::const_iterator f = pending.begin(); f != pending.end(); f++)
+        if (modified_times.find(f->first) == modified_times.end()) gone.push_back(f->first);
+    
+    for (std::vector<std::string>::const_iterator f = gone.begin(); f != gone.end(); f++)
+        Forget(*f);
+    
+    for (std::map<std::string, time_t>::const_iterator f = modified_times.begin(); f != modified_times.end(); f++)
+        Touch(f->first);
+}
+
+//records a change; the file is queued once it has settled
+void CScribeWatcher::Touch(const std::string& file_name)
+{
+    pending[file_name] = watch_clock::now();
+}
+
+//a deleted file no longer needs its parsed model
+void CScribeWatcher::Forget(const std::string& file_name)
+{
+    pending.erase(file_name);
+    
+    std::lock_guard<std::mutex> guard(reader_lock);
+    readers.erase(file_name);
+}
+
+void CScribeWatcher::QueueSettled()
+{
+    watch_clock::time_point now = watch_clock::now();
+    
+    for (std::map<std::string, watch_clock::time_point>::iterator f = pending.begin(); f != pending.end(); )
+    {
+        if (now - f->second >= debounce)
+        {
+            Queue(f->first);
+            f = pending.erase(f);
+        }
+        else
+            f++;
+    }
+}
+
+void CScribeWatcher::Queue(const std::string& file_name)
+{
+    std::lock_guard<std::mutex> guard(queue_lock);
+    
+    if (converting.count(file_name))
+    {
+        changed_while_converting.insert(file_name); //convert again when current conversion is finished
+        return;
+    }
+    
+    if (queued.insert(file_name).second)
+    {
+        queue.push_back(file_name);
+        queue_ready.notify_one();
+    }
+}
+
+void CScribeWatcher::Worker()
+{
+    for (;;)
+    {
+        std::string file_name;
+        
+        {
+            std::unique_lock<std::mutex> guard(queue_lock);
+            queue_ready.wait(guard, [this] { return !queue.empty(); });
+            file_name = queue.front();
+            queue.pop_front();
+            queued.erase(file_name);
+            converting.insert(file_name);
+        }
+        
+        try {
+            Convert(file_name);
+        } catch (std::exception& e) {
+            std::cerr << file_name << ": " << e.what() << std::endl;
+        }
+        
+        bool again = false;
+        
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            converting.erase(file_name);
+            again = changed_while_converting.erase(file_name) > 0;
+        }
+        
+        if (again) Queue(file_name);
+    }
+}
+
+//===================================================================================================
+//
+//  Function:   Convert
+//  Purpose:    Converts one Scribe file. The first conversion of a file parses it; later conversions
+//              reload it so that only modified parts are parsed and only modified pieces are written.
+//  Used by:    Worker
+//
+//===================================================================================================
+
+void CScribeWatcher::Convert(const std::string& file_name)
+{
+    //each worker converts with its own converter, since converters hold the document being built
+    CScribeToNeoScribeXML nsXML(encoder, manifest);
+    std::shared_ptr<CScribeReaderVisitable> scribe_data;
+    
+    {
+        std::lock_guard<std::mutex> guard(reader_lock);
+        
+        //a file deleted or moved away after it was queued keeps no parsed model, whether or not its event has arrived
+        if (!Exists(file_name))
+        {
+            readers.erase(file_name);
+            return;
+        }
+        
+        std::map<std::string, std::shared_ptr<CScribeReaderVisitable> >::iterator found = readers.find(file_name);
+        if (found != readers.end()) scribe_data = found->second;
+    }
+    
+    if (scribe_data)
+    {
+        try {
+            scribe_data->Reload();
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(reader_lock);
+            readers.erase(file_name);   //parsed afresh when it is next changed
+            throw;
+        }
+    }
+    else
+    {
+        if (nsXML.IsCurrent(file_name)) return;
+        
+        scribe_data = std::make_shared<CScribeReaderVisitable>(file_name);
+        
+        //a file removed while it was parsed has already been forgotten, so its model is not kept
+        std::lock_guard<std::mutex> guard(reader_lock);
+        if (Exists(file_name)) readers[file_name] = scribe_data;
+    }
+    
+    std::cout << "Converting " << file_name << " (" << scribe_data->ChangedParts().size() << " changed part(s))..." << std::endl;
+    
+    nsXML.ConvertScribeFile(*scribe_data);
+    manifest->save();
+}
+
+//whether file_name is still a regular file in the directory
+const bool CScribeWatcher::Exists(const std::string& file_name)
+{
+    struct stat info;
+    return stat(file_name.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+//Scribe exports carry the extension .NEU, followed by .gz or .zst if they are compressed
+const bool CScribeWatcher::IsScribeFile(const std::string& file_name)
+{
+    std::string name = file_name;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    
+    static const char* extensions[] = { ".NEU", ".NEU.GZ", ".NEU.ZST" };
+    
+    for (size_t e = 0; e < sizeof(extensions) / sizeof(extensions[0]); e++)
+    {
+        std::string extension = extensions[e];
+        if (name.size() >= extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0) return true;
+    }
+    
+    return false;
+}
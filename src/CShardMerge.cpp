@@ -0,0 +1,99 @@
+//
+//  CShardMerge.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CShardMerge.h"
+#include "CManifest.h"
+#include "CCatalogue.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <cstdio>
+#include <sys/stat.h>
+
+
+CShardMerge::CShardMerge(const std::vector<std::string>& shard_directories)
+: shard_directories(shard_directories)
+{
+    //shards are merged in order of name; should two shards hold the same MEI file the first is kept
+    std::sort(this->shard_directories.begin(), this->shard_directories.end());
+}
+
+//===================================================================================================
+//
+//  Function:   Run
+//  Purpose:    Moves the MEI files recorded in each shard manifest into the current directory and records
+//              them in its manifest. A Scribe file is recorded as converted only if every shard converted
+//              it with the same fingerprint. Catalogue rows of all shards are combined in order of MEI file.
+//  Output:     number of MEI files merged
+//  Used by:    none - public function call
+//
+//===================================================================================================
+
+int CShardMerge::Run()
+{
+    CManifest       manifest(MANIFEST_FILE);
+    CCatalogue      catalogue(CATALOGUE_FILE);
+    std::set<std::string>   merged_files;
+    std::map<std::string, std::pair<uint64_t, size_t> > sources; //fingerprint and number of shards agreeing
+    
+    for (std::vector<std::string>::const_iterator shard = shard_directories.begin(); shard != shard_directories.end(); shard++)
+    {
+        CManifest shard_manifest(*shard + "/" + MANIFEST_FILE);
+        std::vector<std::string> keys = shard_manifest.keys();
+        
+        if (keys.empty()) std::cerr << "Scribe2NeoScribe: nothing to merge in " << *shard << std::endl;
+        
+        for (std::vector<std::string>::const_iterator key = keys.begin(); key != keys.end(); key++)
+        {
+            uint64_t    fingerprint;
+            std::string owner;
+            
+            shard_manifest.lookup(*key, fingerprint, owner);
+            
+            if (owner.empty())
+            {
+                std::map<std::string, std::pair<uint64_t, size_t> >::iterator source = sources.find(*key);
+                
+                if (source == sources.end()) sources[*key] = std::make_pair(fingerprint, 1);
+                else if (source->second.first == fingerprint) source->second.second++;
+                continue;
+            }
+            
+            std::string xml_file_name = BaseName(*key);
+            
+            if (!merged_files.insert(xml_file_name).second)
+            {
+                std::cerr << "Scribe2NeoScribe: " << *key << " already merged from another shard" << std::endl;
+                continue;
+            }
+            
+            //a file that has already been moved by an earlier merge is left where it is
+            struct stat info;
+            if (std::rename(key->c_str(), xml_file_name.c_str()) != 0 && stat(xml_file_name.c_str(), &info) != 0)
+            {
+                std::cerr << "Scribe2NeoScribe: could not move " << *key << std::endl;
+                continue;
+            }
+            
+            manifest.update(xml_file_name, fingerprint, owner);
+        }
+        
+        catalogue.merge(CCatalogue(*shard + "/" + CATALOGUE_FILE));
+    }
+    
+    for (std::map<std::string, std::pair<uint64_t, size_t> >::const_iterator source = sources.begin(); source != sources.end(); source++)
+    {
+        if (source->second.second == shard_directories.size()) manifest.update(source->first, source->second.first);
+    }
+    
+    manifest.save();
+    catalogue.save();
+    
+    return static_cast<int>(merged_files.size());
+}
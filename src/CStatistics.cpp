@@ -0,0 +1,52 @@
+//
+//  CStatistics.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+
+#include "CStatistics.h"
+#include "CScribeCodes.h"
+
+
+void    CStatistics::BeginFile(const CScribeReaderVisitable& scribe_data)
+{
+    codes = scribe_data.GetCodes();
+    files++;
+}
+
+void    CStatistics::CountRow(const scribe_row& row)
+{
+    rows++;
+    if (row.is_comment) comments++;
+    else if (!row.syllable.empty()) syllables++;
+}
+
+void    CStatistics::CountEvent(const scribe_event& event)
+{
+    events++;
+    events_of_type[codes->get_code_type(event.code)]++;
+    
+    for (std::vector<int>::const_iterator pitch = event.pitch_num.begin(); pitch != event.pitch_num.end(); pitch++)
+    {
+        if (*pitch < lowest_pitch) lowest_pitch = *pitch;
+        if (*pitch > highest_pitch) highest_pitch = *pitch;
+    }
+    pitches += event.pitch_num.size();
+}
+
+void    CStatistics::Print(std::ostream& out) const
+{
+    //in the order of code_t
+    const char* type_names[] = { "note", "rest", "ligature", "uneume", "ineume", "mensuration", "clef", "barline", "dot", "accidental", "other" };
+    
+    out << files << " file(s), " << parts << " part(s), " << rows << " row(s) (" << comments << " comment(s), " << syllables << " syllable(s)), " << events << " event(s):";
+    
+    for (int type = code_t::note; type <= code_t::other; type++)
+        if (events_of_type[type]) out << " " << events_of_type[type] << " " << type_names[type];
+    
+    out << "; " << pitches << " pitch(es)";
+    if (pitches) out << ", pitch codes " << lowest_pitch << " to " << highest_pitch;
+    out << "." << std::endl;
+}
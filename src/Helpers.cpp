@@ -7,6 +7,8 @@
 //
 
 #include "Header.h"
+#include <fstream>
+#include <sys/resource.h>
 
 //getline replacement to deal with files from different platforms - currently works for windows and unix line ends
 //http://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
@@ -58,3 +60,72 @@ std::string ZeroPadNumber(int num, int width)
     }
     return result;
 }
+
+//file name without its directory
+
+std::string BaseName(const std::string& path)
+{
+    std::string::size_type slash = path.find_last_of('/');
+    
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+//file name without the .gz or .zst of a compressed file
+
+std::string UncompressedName(const std::string& file_name)
+{
+    static const char* suffixes[] = { ".gz", ".zst" };
+    
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++)
+    {
+        std::string suffix(suffixes[i]);
+        if (file_name.size() > suffix.size() && file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            return file_name.substr(0, file_name.size() - suffix.size());
+    }
+    return file_name;
+}
+
+//64 bit FNV-1a hash of a byte range
+//http://www.isthe.com/chongo/tech/comp/fnv/
+
+uint64_t HashBytes(const char* data, size_t length, uint64_t seed)
+{
+    uint64_t hash = seed;
+    
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    
+    return hash;
+}
+
+//hash of the whole contents of a file; a missing file hashes as empty
+
+uint64_t HashFile(const std::string& file_name, uint64_t seed)
+{
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    char buffer[65536];
+    uint64_t hash = seed;
+    
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+    {
+        hash = HashBytes(buffer, static_cast<size_t>(file.gcount()), hash);
+    }
+    
+    return hash;
+}
+
+size_t PeakResidentBytes()
+{
+    struct rusage usage;
+    
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); //bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; //kilobytes
+#endif
+}
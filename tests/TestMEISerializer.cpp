@@ -0,0 +1,278 @@
+//
+//  TestMEISerializer.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  Checks CMEISerializer against XmlExport, which wrote MEI files before it: documents holding
+//  entities, line ends, non-ASCII text, comments, mixed text and elements and the text following
+//  elements are written by both and compared. Control characters and bytes that are not UTF-8, which
+//  libxml2 writes differently from one version to another, are checked against their character
+//  references. The escape routine, vectorised where the build allows, is checked against a byte at a
+//  time reference on random text. Fragments written in place of stand-ins must read as the elements
+//  they were rendered from, with the ids given in place of theirs. Exits with 1 if any check fails.
+//
+
+#include "CMEISerializer.h"
+
+#include <mei/xmlexport.h>
+#include <mei/shared.h>
+#include <mei/header.h>
+#include <mei/namesdates.h>
+#include <cstdio>
+#include <random>
+
+static int failures = 0;
+
+static void check(const bool passed, const std::string& what, const std::string& expected, const std::string& found)
+{
+    if (passed) return;
+    
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl << "expected:" << std::endl << expected << std::endl << "found:" << std::endl << found << std::endl;
+}
+
+//escapes text as CMEISerializer::escape should, decoding each UTF-8 sequence to check it
+static std::string reference_escape(const std::string& text, const bool attribute)
+{
+    std::string escaped;
+    char reference[8];
+    
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = text[i];
+        
+        if (c == '&') escaped += "&amp;";
+        else if (c == '<') escaped += "&lt;";
+        else if (c == '>') escaped += "&gt;";
+        else if (c == '"' && attribute) escaped += "&quot;";
+        else if (c == '\r') escaped += "&#13;";
+        else if (c == '\n' && attribute) escaped += "&#10;";
+        else if (c == '\t' && attribute) escaped += "&#9;";
+        else if (c >= 0x20 && c < 0x80) escaped += c;
+        else if (c == '\n' || c == '\t') escaped += c;
+        else
+        {
+            //sequence length and smallest character it may hold, by its first byte
+            size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 0;
+            unsigned long smallest = length == 4 ? 0x10000 : length == 3 ? 0x800 : 0x80;
+            unsigned long character = length ? c & (0x7F >> length) : 0;
+            bool valid = length > 0 && i + length <= text.size();
+            
+            for (size_t j = 1; valid && j < length; j++)
+            {
+                valid = (static_cast<unsigned char>(text[i + j]) & 0xC0) == 0x80;
+                character = (character << 6) | (static_cast<unsigned char>(text[i + j]) & 0x3F);
+            }
+            valid = valid && character >= smallest && character <= 0x10FFFF && (character < 0xD800 || character > 0xDFFF);
+            
+            if (valid)
+            {
+                escaped.append(text, i, length);
+                i += length - 1;
+            }
+            else
+            {
+                std::snprintf(reference, sizeof(reference), "&#x%X;", c);
+                escaped += reference;
+            }
+        }
+    }
+    return escaped;
+}
+
+static std::string serialize(MeiDocument* doc)
+{
+    std::string text;
+    CMEISerializer serializer(text);
+    
+    serializer.declaration();
+    serializer.write(doc->getRootElement());
+    return text;
+}
+
+//a document of a few sections, whose texts and attribute values are those given
+static MeiDocument* sample_document(const std::vector<std::string>& texts)
+{
+    MeiDocument* doc = new MeiDocument();
+    Mei* root = new Mei();
+    Music* music = new Music();
+    
+    doc->setRootElement(root);
+    root->addChild(music);
+    
+    for (size_t t = 0; t < texts.size(); t++)
+    {
+        Section* section = new Section();
+        Staff* staff = new Staff();
+        Syllable* syllable = new Syllable();
+        Syl* syl = new Syl();
+        Note* note = new Note();
+        
+        music->addChild(section);
+        section->addChild(staff);
+        staff->addChild(syllable);
+        syllable->addChild(syl);
+        syllable->addChild(note);
+        
+        syl->setValue(texts[t]);
+        note->addAttribute("label", texts[t]);
+        
+        MeiCommentNode* comment = new MeiCommentNode;
+        comment->setValue(" folio " + std::to_string(t + 1) + " ");
+        staff->addChild(comment);
+        
+        //text and elements mixed, as in a title holding a name
+        Title* title = new Title();
+        PersName* name = new PersName();
+        title->setValue("Motet by ");
+        name->setValue(texts[t]);
+        name->setTail(" (" + texts[t] + ")");
+        title->addChild(name);
+        section->addChild(title);
+        
+        //an element whose only text follows an element within it
+        Sb* sb = new Sb();
+        sb->setTail(texts[t]);
+        Item* item = new Item();
+        item->addChild(sb);
+        section->addChild(item);
+    }
+    return doc;
+}
+
+static void check_parity()
+{
+    std::vector<std::string> texts;
+    
+    texts.push_back("Sanctus");
+    texts.push_back("");
+    texts.push_back("A & B < C > D \"E\" 'F'");
+    texts.push_back("line\nbreak\tand tab\r\nand return");
+    texts.push_back("D\xC3\xA9o gr\xC3\xA2tias \xE2\x82\xAC \xF0\x9D\x84\x9E");   //accents, euro sign and G clef
+    texts.push_back("&amp; written as it reads");
+    
+    MeiDocument* doc = sample_document(texts);
+    std::string expected = XmlExport::meiDocumentToText(doc);
+    std::string found = serialize(doc);
+    
+    check(expected == found, "document written as XmlExport writes it", expected, found);
+    delete doc;
+}
+
+static void check_references()
+{
+    static const struct { const char* text; bool attribute; const char* escaped; } cases[] = {
+        { "a\x01" "b\x1F" "c", false, "a&#x1;b&#x1F;c" },
+        { "a\x01" "b\x1F" "c", true, "a&#x1;b&#x1F;c" },
+        { "\x7F", false, "\x7F" },
+        { "bad \xFF byte", false, "bad &#xFF; byte" },
+        { "cut \xC3", true, "cut &#xC3;" },
+        { "overlong \xC0\xAF", false, "overlong &#xC0;&#xAF;" },
+        { "surrogate \xED\xA0\x80", false, "surrogate &#xED;&#xA0;&#x80;" },
+        { "beyond \xF4\x90\x80\x80", false, "beyond &#xF4;&#x90;&#x80;&#x80;" },
+        { "stray \x80 continuation \xC3\xA9", false, "stray &#x80; continuation \xC3\xA9" },
+    };
+    
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        std::string escaped;
+        CMEISerializer::escape(cases[c].text, escaped, cases[c].attribute);
+        check(escaped == cases[c].escaped, std::string("references for ") + cases[c].text, cases[c].escaped, escaped);
+    }
+}
+
+//random text long enough to be scanned in blocks, with special characters at every position of a block,
+//including sequences cut by the end of a block or of the text
+static void check_random(const int count)
+{
+    static const char* pieces[] = { "a", "b", " ", "&", "<", ">", "\"", "'", "\n", "\t", "\r", "\x01", "\x7F",
+        "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9D\x84\x9E", "\xC3", "\xE2\x82", "\xFF", "\x80", "\xED\xA0\x80" };
+    const size_t piece_count = sizeof(pieces) / sizeof(pieces[0]);
+    std::mt19937 random(2026);
+    
+    for (int i = 0; i < count; i++)
+    {
+        std::string text;
+        size_t length = random() % 200;
+        unsigned plain = random() % 8;  //runs of plain text between special characters, to vary their density
+        
+        while (text.size() < length)
+            text += random() % 8 < plain ? "x" : pieces[random() % piece_count];
+        
+        for (int attribute = 0; attribute < 2; attribute++)
+        {
+            std::string escaped = "prefix ";  //text is appended to what is already there
+            CMEISerializer::escape(text, escaped, attribute);
+            std::string expected = "prefix " + reference_escape(text, attribute);
+            check(escaped == expected, "random text " + std::to_string(i), expected, escaped);
+        }
+        if (failures > 10) return;
+    }
+}
+
+//element and everything it contains that is written with an id, in document order
+static void collect_ids(MeiElement* element, std::vector<MeiElement*>& elements)
+{
+    if (dynamic_cast<MeiCommentNode*>(element)) return;
+    elements.push_back(element);
+    
+    const std::vector<MeiElement*>& children = element->getChildren();
+    for (std::vector<MeiElement*>::const_iterator child = children.begin(); child != children.end(); child++)
+        collect_ids(*child, elements);
+}
+
+static void check_fragments()
+{
+    std::vector<std::string> texts(1, "Kyrie & Gloria");
+    texts.push_back("D\xC3\xA9o gr\xC3\xA2tias");
+    
+    for (int pretty = 0; pretty < 2; pretty++)
+    {
+        MeiDocument* doc = sample_document(texts);
+        MeiElement* section = doc->getRootElement()->getChildren()[0]->getChildren()[0];  //mei - music - section
+        std::string whole, spliced, renumbered, ids_set;
+        
+        CMEISerializer writer(whole, pretty);
+        writer.write(doc->getRootElement());
+        
+        //the section is rendered where it is written, within mei and music
+        CMEISerializer::fragment rendered;
+        CMEISerializer::render(section, rendered, pretty, 2, 2);
+        
+        CMEISerializer splicer(spliced, pretty);
+        splicer.stand_in(section, &rendered);
+        splicer.write(doc->getRootElement());
+        check(whole == spliced, "fragment written as the elements it was rendered from", whole, spliced);
+        
+        std::vector<MeiElement*> elements;
+        collect_ids(section, elements);
+        check(rendered.ids.size() == elements.size(), "fragment split at every id", std::to_string(elements.size()), std::to_string(rendered.ids.size()));
+        
+        std::vector<std::string> ids;
+        for (size_t e = 0; e < elements.size(); e++) ids.push_back("x" + std::to_string(e + 1) + "&");
+        
+        CMEISerializer renumberer(renumbered, pretty);
+        renumberer.stand_in(section, &rendered, &ids);
+        renumberer.write(doc->getRootElement());
+        
+        for (size_t e = 0; e < elements.size(); e++) elements[e]->setId(ids[e]);
+        CMEISerializer id_writer(ids_set, pretty);
+        id_writer.write(doc->getRootElement());
+        check(ids_set == renumbered, "fragment written with the ids given", ids_set, renumbered);
+        
+        delete doc;
+    }
+}
+
+int main(int argc, const char * argv[])
+{
+    check_parity();
+    check_references();
+    check_fragments();
+    check_random(argc > 1 ? std::atoi(argv[1]) : 100000);
+    
+    std::cout << (failures ? "TestMEISerializer: " + std::to_string(failures) + " failed" : "TestMEISerializer: passed") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,371 @@
+//
+//  TestMelodicIndex.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  Checks the melodic index against brute force on random corpora. Each corpus is a number of files of
+//  parts of random melodies, posted as CMelodicIndexer posts them, indexed in several segments that are
+//  merged, with its suffixes sorted by 1 to 4 threads. The suffix array and LCPs are checked against
+//  direct comparison of the suffixes, and the index is saved and mapped again, then searched with Find
+//  and Match for fragments taken from the corpus, altered and made at random, the hits being compared
+//  with those of a scan of every part. Indexes damaged in various ways must be refused when opened.
+//  Every few corpora are large enough for the suffixes to be sorted in several runs. A Scribe file whose
+//  melody runs below and above the c of its F clef is indexed, and its intervals checked against those
+//  worked out by hand, in its keys and in the text that Match searches. Run from the directory holding
+//  data/. Exits with 1 if any check fails.
+//
+
+#include "CMelodicIndex.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+std::string PROCWORKINGDIRECTORY = "./";
+
+static const std::string index_file = "TestMelodicIndex.index";
+static const std::string scribe_file = "TestMelodicIndex.NEU";
+static const size_t header_size = 72;     //magic, version, gram length and seven counts
+static int failures = 0;
+
+static void check(const bool passed, const std::string& what)
+{
+    if (passed) return;
+    
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+//a corpus as the intervals of each of its parts, in the order of the parts of the index
+struct corpus {
+    std::vector<std::vector<int> >  intervals;
+    std::vector<uint32_t>           files;      //of each part
+};
+
+//key of the n-gram starting at note of a part, padded with 0 where the part ends
+static uint32_t gram_key(const std::vector<int>& intervals, const size_t note)
+{
+    uint32_t key = 0;
+    
+    for (size_t k = 0; k < CMelodicIndexer::gram_length; k++)
+        key = (key << 8) | (note + k < intervals.size() ? static_cast<uint32_t>(intervals[note + k] + 128) : 0);
+    
+    return key;
+}
+
+//a random corpus, indexed into segments of a few files each
+static void make_corpus(std::mt19937& random, const size_t largest_part, corpus& made, std::vector<melodic_segment>& segments)
+{
+    const size_t file_count = 1 + random() % 6;
+    const int    range = 1 + random() % 4;     //largest step, so that some corpora repeat themselves often
+    
+    for (size_t f = 0; f < file_count; f++)
+    {
+        if (segments.empty() || random() % 2) segments.push_back(melodic_segment());
+        
+        melodic_segment& segment = segments.back();
+        const size_t part_count = 1 + random() % 4;
+        
+        segment.files.push_back("file " + std::to_string(f) + ".NEU");
+        
+        for (size_t p = 0; p < part_count; p++)
+        {
+            const size_t    note_count = random() % (largest_part + 1);
+            const uint32_t  part = static_cast<uint32_t>(segment.parts.size());
+            melodic_part    indexed = { static_cast<uint32_t>(segment.files.size() - 1), static_cast<uint32_t>(p + 1), segment.notes.size() };
+            std::vector<int> intervals;
+            
+            segment.parts.push_back(indexed);
+            
+            for (size_t n = 0; n < note_count; n++)
+            {
+                melodic_note note = { static_cast<uint32_t>(n / 3 + 1), static_cast<uint32_t>(n % 3 + 1) };
+                segment.notes.push_back(note);
+                if (n + 1 < note_count) intervals.push_back(static_cast<int>(random() % (2 * range + 1)) - range);
+            }
+            
+            for (size_t n = 0; n < intervals.size(); n++)
+            {
+                melodic_posting posting = { gram_key(intervals, n), part, static_cast<uint32_t>(n) };
+                segment.postings.push_back(posting);
+            }
+            
+            made.intervals.push_back(intervals);
+            made.files.push_back(static_cast<uint32_t>(f));
+        }
+    }
+    
+    for (std::vector<melodic_segment>::iterator s = segments.begin(); s != segments.end(); s++) s->sort();
+}
+
+//every suffix in order after the one before it, and sharing with it as many intervals as its LCP says
+static void check_suffixes(const melodic_segment& index, const int jobs)
+{
+    const std::vector<uint8_t>& text = index.text;
+    size_t starts = 0;
+    
+    for (size_t i = 0; i < text.size(); i++) if (text[i]) starts++;
+    
+    check(index.suffixes.size() == starts && index.lcp.size() == starts, "a suffix for each note followed by another, with " + std::to_string(jobs) + " jobs");
+    
+    for (size_t j = 0; j < index.suffixes.size() && j < index.lcp.size(); j++)
+    {
+        const uint32_t suffix = index.suffixes[j];
+        
+        if (suffix >= text.size() || !text[suffix])
+        {
+            check(false, "suffix " + std::to_string(j) + " starts at a note followed by another");
+            return;
+        }
+        if (j == 0)
+        {
+            check(index.lcp[0] == 0, "LCP of the first suffix");
+            continue;
+        }
+        
+        const uint32_t before = index.suffixes[j - 1];
+        uint32_t common = 0;
+        
+        while (text[suffix + common] && text[suffix + common] == text[before + common]) common++;
+        
+        check(index.lcp[j] == common, "LCP of suffix " + std::to_string(j) + " with " + std::to_string(jobs) + " jobs");
+        check(text[before + common] < text[suffix + common] || (!text[suffix + common] && before < suffix), "order of suffix " + std::to_string(j) + " with " + std::to_string(jobs) + " jobs");
+    }
+}
+
+//the places fragment occurs whole, and where its longest beginning found anywhere occurs, by scanning every part
+static size_t scan(const corpus& scanned, const std::vector<int>& fragment, std::vector<melodic_posting>& whole, std::vector<melodic_posting>& longest)
+{
+    size_t matched = 0;
+    
+    whole.clear();
+    longest.clear();
+    
+    for (size_t p = 0; p < scanned.intervals.size(); p++)
+    {
+        const std::vector<int>& intervals = scanned.intervals[p];
+        
+        for (size_t n = 0; n < intervals.size(); n++)
+        {
+            size_t common = 0;
+            while (common < fragment.size() && n + common < intervals.size() && intervals[n + common] == fragment[common]) common++;
+            
+            melodic_posting hit = { 0, static_cast<uint32_t>(p), static_cast<uint32_t>(n) };
+            
+            if (common == fragment.size()) whole.push_back(hit);
+            if (common && common > matched) longest.clear();
+            if (common && common >= matched)
+            {
+                matched = common;
+                longest.push_back(hit);
+            }
+        }
+    }
+    return matched;
+}
+
+static bool same_places(const std::vector<melodic_posting>& a, const std::vector<melodic_posting>& b)
+{
+    if (a.size() != b.size()) return false;
+    
+    for (size_t k = 0; k < a.size(); k++)
+        if (a[k].part != b[k].part || a[k].note != b[k].note) return false;
+    
+    return true;
+}
+
+//fragments taken from the corpus, some altered from a point on, and some made at random
+static void check_searches(std::mt19937& random, const corpus& searched, const CMelodicIndex& index, const int queries)
+{
+    std::vector<melodic_posting> found, whole, longest;
+    
+    for (int q = 0; q < queries; q++)
+    {
+        const std::vector<int>& intervals = searched.intervals[random() % searched.intervals.size()];
+        const size_t length = 1 + random() % 14;
+        std::vector<int> fragment;
+        
+        if (q % 4 == 0 || intervals.size() < length)
+        {
+            for (size_t k = 0; k < length; k++) fragment.push_back(static_cast<int>(random() % 9) - 4);
+        }
+        else
+        {
+            size_t at = random() % (intervals.size() - length + 1);
+            fragment.assign(intervals.begin() + at, intervals.begin() + at + length);
+            if (q % 4 == 1) for (size_t k = random() % length; k < length; k++) fragment[k] = static_cast<int>(random() % 9) - 4;
+        }
+        
+        const size_t matched = scan(searched, fragment, whole, longest);
+        
+        index.Find(fragment, found);
+        check(same_places(found, whole), "Find of a fragment of " + std::to_string(length) + " intervals");
+        
+        for (std::vector<melodic_posting>::const_iterator hit = found.begin(); hit != found.end(); hit++)
+            check(hit->key == gram_key(searched.intervals[hit->part], hit->note), "key of a hit of Find");
+        
+        check(index.Match(fragment, found) == matched, "intervals matched by Match");
+        check(same_places(found, longest), "Match of a fragment of " + std::to_string(length) + " intervals");
+        
+        for (std::vector<melodic_posting>::const_iterator hit = found.begin(); hit != found.end(); hit++)
+        {
+            check(hit->key == gram_key(searched.intervals[hit->part], hit->note), "key of a hit of Match");
+            check(index.FileName(index.Part(hit->part).file) == "file " + std::to_string(searched.files[hit->part]) + ".NEU", "file of a hit");
+            check(index.Note(*hit).row == hit->note / 3 + 1 && index.Note(*hit).event == hit->note % 3 + 1, "note of a hit");
+        }
+        if (failures > 10) return;
+    }
+}
+
+//the index saved, with the bytes at offset replaced, or cut short to size
+static bool opens_damaged(const std::string& saved, const size_t offset, const std::string& bytes, const size_t size)
+{
+    std::string damaged = saved.substr(0, size);
+    
+    if (offset < damaged.size()) damaged.replace(offset, std::min(bytes.size(), damaged.size() - offset), bytes);
+    
+    std::ofstream(index_file.c_str(), std::ios::binary | std::ios::trunc).write(damaged.data(), static_cast<std::streamsize>(damaged.size()));
+    
+    try {
+        CMelodicIndex index(index_file);
+        return true;
+    } catch (std::runtime_error&) {
+        return false;
+    }
+}
+
+//an index with every section damaged in turn, and cut short, is refused rather than read out of bounds
+static void check_damage(std::mt19937& random)
+{
+    std::ifstream in(index_file.c_str(), std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::string large(4, '\xff');
+    
+    check(opens_damaged(saved, 0, "", saved.size()), "an undamaged index opens");
+    
+    for (size_t cut = 0; cut < saved.size(); cut += 1 + random() % 64)
+        check(!opens_damaged(saved, 0, "", cut), "an index cut short to " + std::to_string(cut) + " bytes is refused");
+    
+    //a large number in place of any four bytes after the header either leaves the index usable or is refused
+    for (size_t offset = header_size; offset + 4 <= saved.size(); offset += 4)
+    {
+        if (!opens_damaged(saved, offset, large, saved.size())) continue;
+        
+        CMelodicIndex index(index_file);
+        std::vector<melodic_posting> hits;
+        
+        for (int q = 0; q < 20; q++)
+        {
+            std::vector<int> fragment(1 + random() % 8);
+            for (size_t k = 0; k < fragment.size(); k++) fragment[k] = static_cast<int>(random() % 9) - 4;
+            
+            index.Find(fragment, hits);
+            for (size_t h = 0; h < hits.size(); h++) { index.Note(hits[h]); index.FileName(index.Part(hits[h].part).file); }
+            index.Match(fragment, hits);
+            for (size_t h = 0; h < hits.size(); h++) { index.Note(hits[h]); index.FileName(index.Part(hits[h].part).file); }
+        }
+    }
+}
+
+//a chant part under an F clef on line 5, whose c is at position 9, of puncta at positions from 1 to 16:
+//b2 c3 d3 c4 c3 b2 c5, rising a step, a step and a sixth, falling an octave and a step, then rising two octaves
+static const int clef_positions[] = { 1, 2, 3, 9, 2, 1, 16 };
+static const int clef_intervals[] = { 1, 1, 6, -7, -1, 15 };
+
+static void write_clef_file()
+{
+    const std::string row = "\x03\x04" "C\x07";
+    std::ofstream out(scribe_file.c_str(), std::ios::binary | std::ios::trunc);
+    
+    out << "S^C^R^I^B^E^L\r\n" << ">AA1" << std::string(6, ' ') << "Feast" << std::string(35, ' ') << "Office" << std::string(14, ' ')
+        << "Ant" << std::string(17, ' ') << "1r" << std::string(18, ' ') << "1000    \r\n";
+    out << row << "F5" << row << "\r\n";
+    
+    for (size_t n = 0; n < sizeof(clef_positions) / sizeof(clef_positions[0]); n++)
+        out << row << "B" << clef_positions[n] << ";Ky" << row << "\r\n";
+}
+
+//the intervals of a melody crossing the c of its clef, as indexed from a Scribe file
+static void check_clef_steps()
+{
+    const std::vector<int> intervals(clef_intervals, clef_intervals + sizeof(clef_intervals) / sizeof(clef_intervals[0]));
+    melodic_segment index;
+    
+    write_clef_file();
+    CMelodicIndexer::Build(std::vector<std::string>(1, scribe_file), 1, index);
+    index.sort_suffixes(1);
+    index.save(index_file);
+    std::remove(scribe_file.c_str());
+    
+    check(index.notes.size() == intervals.size() + 1, "a note for each punctum of the clef file");
+    
+    //the text searched by Match holds the same intervals as the keys, as key bytes, and 0 at the last note
+    for (size_t n = 0; n < index.text.size() && n < index.notes.size(); n++)
+        check(index.text[n] == (n < intervals.size() ? intervals[n] + 128 : 0), "text at note " + std::to_string(n) + " of the clef file");
+    
+    check(index.suffixes.size() == intervals.size(), "a suffix for each interval of the clef file");
+    
+    for (std::vector<melodic_posting>::const_iterator posting = index.postings.begin(); posting != index.postings.end(); posting++)
+        check(posting->key == gram_key(intervals, posting->note), "key of the n-gram at note " + std::to_string(posting->note) + " of the clef file");
+    
+    CMelodicIndex saved(index_file);
+    std::vector<melodic_posting> hits;
+    
+    saved.Find(intervals, hits);
+    check(hits.size() == 1 && hits[0].note == 0, "Find of the melody of the clef file");
+    
+    check(saved.Match(intervals, hits) == intervals.size() && hits.size() == 1 && hits[0].note == 0, "Match of the melody of the clef file");
+    
+    //the octave and step down across the clef's c, then a turn the melody does not take
+    std::vector<int> turn(intervals.begin() + 2, intervals.begin() + 5);
+    turn.push_back(2);
+    check(saved.Match(turn, hits) == 3 && hits.size() == 1 && hits[0].note == 2, "Match of the melody crossing the clef's c");
+}
+
+int main(int argc, const char * argv[])
+{
+    const int       corpus_count = argc > 1 ? std::atoi(argv[1]) : 600;
+    std::mt19937    random(2026);
+    
+    for (int c = 0; c < corpus_count && failures <= 10; c++)
+    {
+        corpus                          made;
+        std::vector<melodic_segment>    segments;
+        melodic_segment                 index;
+        const bool                      large = c % 100 == 99;
+        
+        make_corpus(random, large ? 40000 : 60, made, segments);
+        index.merge(segments);
+        
+        std::vector<uint32_t> single_suffixes;
+        
+        for (int jobs = 1; jobs <= 4; jobs++)
+        {
+            index.sort_suffixes(jobs);
+            check_suffixes(index, jobs);
+            
+            if (jobs == 1) single_suffixes = index.suffixes;
+            else check(index.suffixes == single_suffixes, "the same suffix array with " + std::to_string(jobs) + " jobs");
+        }
+        
+        index.save(index_file);
+        
+        {
+            CMelodicIndex saved(index_file);
+            
+            check(saved.FileCount() == index.files.size() && saved.NoteCount() == index.notes.size(), "counts of the saved index");
+            check_searches(random, made, saved, large ? 50 : 200);
+        }
+        
+        if (c % 50 == 0) check_damage(random);
+    }
+    
+    check_clef_steps();
+    std::remove(index_file.c_str());
+    
+    std::cout << (failures ? "TestMelodicIndex: " + std::to_string(failures) + " failed" : "TestMelodicIndex: passed") << std::endl;
+    return failures ? 1 : 0;
+}
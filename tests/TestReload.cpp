@@ -0,0 +1,142 @@
+//
+//  TestReload.cpp
+//  Scribe2NeoScribe
+//
+//  Created by Jason Stoessel on 18/10/2026.
+//  Copyright (c) 2026 The Early Music eResearch System (THEMES). All rights reserved.
+//
+//  Checks that converting a reloaded Scribe file writes every MEI file it should, as watch mode does.
+//  A chant file is converted, then a part is inserted before its others, which renumbers them and so
+//  renames their MEI files although their parts are unchanged; the file is reloaded and converted again,
+//  and every MEI file must exist. A part is then removed, and an MEI file deleted, and each must be
+//  written again after the next reload. Run from the directory holding data/. Exits with 1 if any
+//  check fails.
+//
+
+#include "CScribeToNeoScribeXML.h"
+#include "CScribeReaderVisitable.h"
+#include "CManifest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+
+std::string PROCWORKINGDIRECTORY = "./";
+
+static const std::string scribe_file = "TestReload.NEU";
+static const std::string manifest_file = "TestReload.manifest";
+static int failures = 0;
+
+static void check(const bool passed, const std::string& what)
+{
+    if (passed) return;
+    
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+static std::string field(const std::string& text, const size_t width)
+{
+    return text + std::string(width - text.size(), ' ');
+}
+
+//a chant part whose text, and so whose title, is syllable
+static std::string chant_part(const std::string& syllable, const int cao_num)
+{
+    const std::string row = "\x03\x04" "C\x07";
+    
+    return ">" + field("AA1", 10) + field("Feast", 40) + field("Office", 20) + field("Ant", 20) + field("1r", 20) + field(std::to_string(cao_num), 8) + "\r\n"
+           + row + "C7" + row + "\r\n"
+           + row + "B5;" + syllable + "-" + row + "\r\n"
+           + row + "V6 +EP4 3;" + syllable + row + "\r\n";
+}
+
+static void write_scribe_file(const std::vector<std::string>& parts)
+{
+    std::ofstream out(scribe_file.c_str(), std::ios::binary | std::ios::trunc);
+    
+    out << "S^C^R^I^B^E^L\r\n";
+    for (size_t p = 0; p < parts.size(); p++) out << parts[p];
+}
+
+//name of the MEI file of the part of a chant file at part_id, from 1
+static std::string output_name(const int part_id, const int cao_num)
+{
+    return "AA1" + ZeroPadNumber(part_id, 4) + " (" + std::to_string(cao_num) + ").xml";
+}
+
+static bool exists(const std::string& file_name)
+{
+    struct stat info;
+    return stat(file_name.c_str(), &info) == 0;
+}
+
+//converts the file as watch mode does, with a converter of its own sharing the manifest
+static void convert(CScribeReaderVisitable& scribe_data, CManifest& manifest)
+{
+    CScribeToNeoScribeXML nsXML("Tester", &manifest);
+    nsXML.ConvertScribeFile(scribe_data);
+}
+
+//a file converted, then reloaded and converted again as it is edited
+static void check_reloads()
+{
+    std::vector<std::string> parts;
+    std::vector<int> cao_nums;
+    
+    parts.push_back(chant_part("Ky", 1001));
+    parts.push_back(chant_part("Al", 1002));
+    cao_nums.push_back(1001);
+    cao_nums.push_back(1002);
+    write_scribe_file(parts);
+    
+    CManifest manifest(manifest_file);
+    CScribeReaderVisitable scribe_data(scribe_file);
+    
+    convert(scribe_data, manifest);
+    
+    for (size_t p = 0; p < cao_nums.size(); p++)
+        check(exists(output_name(static_cast<int>(p) + 1, cao_nums[p])), "first conversion writes " + output_name(static_cast<int>(p) + 1, cao_nums[p]));
+    
+    //a part inserted first renames the MEI files of the unchanged parts after it
+    parts.insert(parts.begin(), chant_part("Do", 1000));
+    cao_nums.insert(cao_nums.begin(), 1000);
+    write_scribe_file(parts);
+    scribe_data.Reload();
+    
+    check(scribe_data.ChangedParts().size() == 1, "only the inserted part is reparsed");
+    convert(scribe_data, manifest);
+    
+    for (size_t p = 0; p < cao_nums.size(); p++)
+        check(exists(output_name(static_cast<int>(p) + 1, cao_nums[p])), "a part inserted before it writes " + output_name(static_cast<int>(p) + 1, cao_nums[p]));
+    
+    //a part removed renames the MEI files after it, and a deleted MEI file is written again
+    parts.erase(parts.begin() + 1);
+    cao_nums.erase(cao_nums.begin() + 1);
+    write_scribe_file(parts);
+    std::remove(output_name(1, cao_nums[0]).c_str());
+    scribe_data.Reload();
+    
+    check(scribe_data.ChangedParts().empty(), "no part is reparsed when one is removed");
+    convert(scribe_data, manifest);
+    
+    for (size_t p = 0; p < cao_nums.size(); p++)
+        check(exists(output_name(static_cast<int>(p) + 1, cao_nums[p])), "a part removed before it writes " + output_name(static_cast<int>(p) + 1, cao_nums[p]));
+}
+
+int main()
+{
+    std::remove(manifest_file.c_str());
+    check_reloads();
+    
+    std::remove(scribe_file.c_str());
+    std::remove(manifest_file.c_str());
+    std::remove(output_name(1, 1000).c_str());
+    std::remove(output_name(2, 1001).c_str());
+    std::remove(output_name(3, 1002).c_str());
+    std::remove(output_name(1, 1001).c_str());
+    std::remove(output_name(2, 1002).c_str());
+    
+    std::cout << (failures ? "TestReload: " + std::to_string(failures) + " failed" : "TestReload: passed") << std::endl;
+    return failures ? 1 : 0;
+}